@@ -0,0 +1,282 @@
+///////////////////////////////////////////////////////////////////////////////
+// allocstats.hh
+//
+// Heap and resident-memory instrumentation for solver runs: number of
+// allocations, bytes allocated, peak live heap, and peak resident set size
+// (RSS) over a measured region.
+//
+// Heap statistics need the global operator new/delete replacements below,
+// which are compiled only when ALLOCSTATS_REPLACE_OPERATOR_NEW is defined
+// before this header is included; do that in exactly one translation unit
+// of a program (a benchmark driver, for example). Without them,
+// allocation_tracking_enabled() is false and the heap fields read as zero,
+// but peak RSS still works.
+//
+// How to use:
+//
+//  MemoryMeter meter;
+//  meter.start();
+//  // run the code you want measured
+//  MemoryUsage usage = meter.stop();
+//  cout << "Peak heap: " << usage.peak_heap_bytes << " bytes" << endl;
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+
+// Process-wide heap counters, updated by the operator new/delete
+// replacements.
+struct AllocationCounters
+{
+	std::atomic<uint64_t> allocations{0};
+	std::atomic<uint64_t> allocated_bytes{0};
+	std::atomic<int64_t> live_bytes{0};
+	std::atomic<int64_t> peak_live_bytes{0};
+	std::atomic<bool> enabled{false};
+};
+
+inline AllocationCounters& allocation_counters()
+{
+	static AllocationCounters counters;
+	return counters;
+}
+
+// True when this program counts heap allocations.
+inline bool allocation_tracking_enabled()
+{
+	return allocation_counters().enabled.load(std::memory_order_relaxed);
+}
+
+
+// Memory used by one measured region.
+struct MemoryUsage
+{
+	// Heap allocations made, and the bytes they requested (as usable size).
+	uint64_t allocations = 0;
+	uint64_t allocated_bytes = 0;
+
+	// Highest live heap above what was live when the region started.
+	uint64_t peak_heap_bytes = 0;
+
+	// Peak resident set size of the process during the region. When the
+	// kernel does not allow resetting the high-water mark, this is the
+	// peak since the process started.
+	uint64_t peak_rss_bytes = 0;
+};
+
+
+// Read a "Name:   1234 kB" line from /proc/self/status, in bytes; 0 when
+// unavailable.
+inline uint64_t read_proc_status_bytes(const char* name)
+{
+	FILE* f = std::fopen("/proc/self/status", "r");
+	if (!f)
+	{
+		return 0;
+	}
+
+	uint64_t result = 0;
+	char line[256];
+	const size_t name_length = std::strlen(name);
+	while (std::fgets(line, sizeof(line), f))
+	{
+		if (std::strncmp(line, name, name_length) == 0 && line[name_length] == ':')
+		{
+			result = std::strtoull(line + name_length + 1, nullptr, 10) * 1024;
+			break;
+		}
+	}
+	std::fclose(f);
+	return result;
+}
+
+// Reset the kernel's peak RSS for this process. Returns false when the
+// kernel does not support it.
+inline bool reset_peak_rss()
+{
+	FILE* f = std::fopen("/proc/self/clear_refs", "w");
+	if (!f)
+	{
+		return false;
+	}
+	bool ok = std::fputs("5", f) >= 0;
+	return std::fclose(f) == 0 && ok;
+}
+
+// Peak RSS of the process, in bytes.
+inline uint64_t peak_rss_bytes()
+{
+	uint64_t peak = read_proc_status_bytes("VmHWM");
+	if (peak == 0)
+	{
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+		{
+			peak = uint64_t(usage.ru_maxrss) * 1024;
+		}
+	}
+	return peak;
+}
+
+
+// Measures the memory used between start() and stop(). Heap figures cover
+// every thread of the process, so measure one solve at a time.
+class MemoryMeter
+{
+	//
+	public:
+
+		void start()
+		{
+			reset_peak_rss();
+
+			AllocationCounters& counters = allocation_counters();
+			_allocations = counters.allocations.load();
+			_allocated_bytes = counters.allocated_bytes.load();
+			_live_bytes = counters.live_bytes.load();
+			counters.peak_live_bytes.store(_live_bytes);
+		}
+
+		MemoryUsage stop() const
+		{
+			AllocationCounters& counters = allocation_counters();
+			MemoryUsage usage;
+			usage.allocations = counters.allocations.load() - _allocations;
+			usage.allocated_bytes = counters.allocated_bytes.load() - _allocated_bytes;
+			int64_t peak = counters.peak_live_bytes.load() - _live_bytes;
+			usage.peak_heap_bytes = peak > 0 ? peak : 0;
+			usage.peak_rss_bytes = peak_rss_bytes();
+			return usage;
+		}
+
+	//
+	private:
+		uint64_t _allocations = 0;
+		uint64_t _allocated_bytes = 0;
+		int64_t _live_bytes = 0;
+};
+
+
+#ifdef ALLOCSTATS_REPLACE_OPERATOR_NEW
+
+// Record an allocation of p, whose size is taken from the allocator so
+// that frees can be matched without a header.
+inline void* allocstats_record_new(void* p)
+{
+	if (p)
+	{
+		AllocationCounters& counters = allocation_counters();
+		int64_t size = malloc_usable_size(p);
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+		counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+		int64_t live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		int64_t peak = counters.peak_live_bytes.load(std::memory_order_relaxed);
+		while (live > peak && !counters.peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{
+		}
+	}
+	return p;
+}
+
+// The replacements pair malloc with free by design.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+inline void allocstats_record_delete(void* p)
+{
+	if (p)
+	{
+		allocation_counters().live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+		std::free(p);
+	}
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+inline void* allocstats_new(size_t size, size_t alignment)
+{
+	if (size == 0)
+	{
+		size = 1;
+	}
+	for (;;)
+	{
+		void* p = nullptr;
+		if (alignment <= alignof(std::max_align_t))
+		{
+			p = std::malloc(size);
+		}
+		else if (posix_memalign(&p, alignment, size) != 0)
+		{
+			p = nullptr;
+		}
+		if (p)
+		{
+			return allocstats_record_new(p);
+		}
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+		{
+			return nullptr;
+		}
+		handler();
+	}
+}
+
+// Turn counting on before main() runs.
+static const bool allocstats_enabled = (allocation_counters().enabled = true);
+
+void* operator new(size_t size)
+{
+	void* p = allocstats_new(size, alignof(std::max_align_t));
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* p = allocstats_new(size, size_t(alignment));
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocstats_new(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocstats_new(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocstats_new(size, size_t(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocstats_new(size, size_t(alignment)); }
+
+void operator delete(void* p) noexcept { allocstats_record_delete(p); }
+void operator delete[](void* p) noexcept { allocstats_record_delete(p); }
+void operator delete(void* p, size_t) noexcept { allocstats_record_delete(p); }
+void operator delete[](void* p, size_t) noexcept { allocstats_record_delete(p); }
+void operator delete(void* p, std::align_val_t) noexcept { allocstats_record_delete(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { allocstats_record_delete(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { allocstats_record_delete(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { allocstats_record_delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { allocstats_record_delete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { allocstats_record_delete(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { allocstats_record_delete(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { allocstats_record_delete(p); }
+
+#endif
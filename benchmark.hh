@@ -0,0 +1,602 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmark.hh
+//
+// Repeated-trial benchmarking of the solvers: warmup runs, many timed
+// trials, outlier rejection, summary statistics, and CSV output of both the
+// summaries and every individual sample.
+//
+// How to use:
+//
+//  BenchmarkSuite suite;
+//  suite.run("dynamic", n, 2000, [&]() { return dynamic_max_calories(foods, 2000); });
+//  suite.write_summary_csv(summary_file);
+//  suite.write_samples_csv(samples_file);
+//
+// With BenchmarkOptions::counters set, every trial is also measured with
+// PerfCounters (timer.hh), and the CSVs gain counter columns.
+//
+// With BenchmarkOptions::memory set, one extra untimed run of each point is
+// measured with MemoryMeter (allocstats.hh), starting from an empty
+// SolverScratch so that the solver's tables count against it.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+#include "allocstats.hh"
+#include "maxcalorie.hh"
+#include "timer.hh"
+
+
+// Force the compiler to materialize value, so the computation producing it
+// cannot be optimized away.
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Force the compiler to assume all memory may have been read and written.
+inline void clobber_memory()
+{
+	asm volatile("" : : : "memory");
+}
+
+
+// Pin the calling thread to one CPU, so trials are not migrated between
+// cores (and their caches) mid-run. cpu < 0 pins to the CPU the thread is
+// currently running on. Returns false when pinning is not possible.
+bool pin_to_cpu(int cpu = -1)
+{
+	if (cpu < 0)
+	{
+		cpu = sched_getcpu();
+		if (cpu < 0)
+		{
+			return false;
+		}
+	}
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+
+// How a BenchmarkSuite runs each benchmark.
+struct BenchmarkOptions
+{
+	// Untimed runs before the trials, to warm caches and scratch buffers.
+	int warmup = 2;
+
+	// Timed runs.
+	int trials = 11;
+
+	// Samples outside [Q1 - k * IQR, Q3 + k * IQR] are rejected as outliers
+	// before the statistics are computed; k <= 0 keeps every sample.
+	double outlier_iqr_factor = 1.5;
+
+	// Pin the benchmarking thread to a CPU (see pin_to_cpu).
+	bool pin_cpu = true;
+	int cpu = -1;
+
+	// Also read hardware performance counters around every trial.
+	bool counters = false;
+
+	// Also measure the memory used by one solve of every point.
+	bool memory = false;
+};
+
+
+// All samples and summary statistics of one (algorithm, n, W) point.
+// Statistics are computed over the samples that are not outliers.
+struct BenchmarkResult
+{
+	std::string algorithm;
+	int n = 0;
+	double total_weight = 0;
+
+	// Seconds per trial, in the order the trials ran.
+	std::vector<double> samples;
+	std::vector<bool> outlier;
+
+	size_t kept = 0;
+	double median = 0, p95 = 0, mean = 0, stddev = 0, min = 0, max = 0;
+
+	// Hardware counters per trial, and their medians over the kept trials;
+	// empty / NaN unless BenchmarkOptions::counters is set.
+	std::vector<PerfCounterValues> counters;
+	PerfCounterValues median_counters;
+
+	// Memory used by one solve; zero unless BenchmarkOptions::memory is set.
+	MemoryUsage memory;
+
+	// Item-capacity cells of the problem (n * W), for per-cell rates.
+	double cells() const { return double(n) * total_weight; }
+};
+
+
+// Value at quantile q (0 to 1) of sorted, by linear interpolation.
+double sorted_quantile(const std::vector<double>& sorted, double q)
+{
+	assert(!sorted.empty());
+	double position = q * (sorted.size() - 1);
+	size_t below = size_t(position);
+	if (below + 1 >= sorted.size())
+	{
+		return sorted.back();
+	}
+	double fraction = position - below;
+	return sorted[below] + fraction * (sorted[below + 1] - sorted[below]);
+}
+
+
+// Median of the finite entries of values (NaN if there are none).
+double median_of(std::vector<double> values)
+{
+	values.erase(
+		std::remove_if(values.begin(), values.end(), [](double v) { return !std::isfinite(v); }),
+		values.end()
+	);
+	if (values.empty())
+	{
+		return NAN;
+	}
+	std::sort(values.begin(), values.end());
+	return sorted_quantile(values, 0.5);
+}
+
+
+// Mark outliers in result.samples and fill in its statistics.
+void summarize_benchmark(BenchmarkResult& result, double outlier_iqr_factor)
+{
+	const auto& samples = result.samples;
+	result.outlier.assign(samples.size(), false);
+	if (samples.empty())
+	{
+		return;
+	}
+
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+
+	if (outlier_iqr_factor > 0 && samples.size() >= 4)
+	{
+		double q1 = sorted_quantile(sorted, 0.25), q3 = sorted_quantile(sorted, 0.75);
+		double low = q1 - outlier_iqr_factor * (q3 - q1), high = q3 + outlier_iqr_factor * (q3 - q1);
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			result.outlier[i] = samples[i] < low || samples[i] > high;
+		}
+	}
+
+	std::vector<double> kept;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		if (!result.outlier[i])
+		{
+			kept.push_back(samples[i]);
+		}
+	}
+	std::sort(kept.begin(), kept.end());
+
+	double sum = 0;
+	for (double sample : kept)
+	{
+		sum += sample;
+	}
+
+	result.kept = kept.size();
+	result.median = sorted_quantile(kept, 0.5);
+	result.p95 = sorted_quantile(kept, 0.95);
+	result.mean = sum / kept.size();
+	result.min = kept.front();
+	result.max = kept.back();
+
+	double squares = 0;
+	for (double sample : kept)
+	{
+		squares += (sample - result.mean) * (sample - result.mean);
+	}
+	result.stddev = kept.size() > 1 ? std::sqrt(squares / (kept.size() - 1)) : 0;
+
+	if (!result.counters.empty())
+	{
+		auto median_counter = [&](double PerfCounterValues::* counter)
+		{
+			std::vector<double> values;
+			for (size_t i = 0; i < result.counters.size(); i++)
+			{
+				if (!result.outlier[i])
+				{
+					values.push_back(result.counters[i].*counter);
+				}
+			}
+			return median_of(values);
+		};
+		result.median_counters.cycles = median_counter(&PerfCounterValues::cycles);
+		result.median_counters.instructions = median_counter(&PerfCounterValues::instructions);
+		result.median_counters.cache_misses = median_counter(&PerfCounterValues::cache_misses);
+		result.median_counters.branch_misses = median_counter(&PerfCounterValues::branch_misses);
+		result.median_counters.llc_loads = median_counter(&PerfCounterValues::llc_loads);
+	}
+}
+
+
+// Roughly log-spaced integers from low to high (inclusive), with about
+// per_decade values per factor of ten, without duplicates.
+std::vector<int> log_spaced(int low, int high, int per_decade)
+{
+	assert(low > 0 && low <= high && per_decade > 0);
+	std::vector<int> result;
+	const double step = std::pow(10.0, 1.0 / per_decade);
+	for (double x = low; ; x *= step)
+	{
+		int value = std::min(high, int(std::lround(x)));
+		if (result.empty() || value != result.back())
+		{
+			result.push_back(value);
+		}
+		if (value == high)
+		{
+			break;
+		}
+	}
+	return result;
+}
+
+
+// The asymptotic operation count of a solver on n items and capacity W:
+// n * 2^n for the exhaustive search, n * W for dynamic programming.
+// Returns NaN for an algorithm with no known model.
+double complexity_model(const std::string& algorithm, int n, double total_weight)
+{
+	if (algorithm == "exhaustive")
+	{
+		return n * std::ldexp(1.0, n);
+	}
+	if (algorithm == "dynamic")
+	{
+		return double(n) * (total_weight + 1);
+	}
+	return NAN;
+}
+
+
+// One measured time, as read back from a benchmark CSV.
+struct TimingPoint
+{
+	std::string algorithm;
+	int n;
+	double total_weight;
+	double seconds;
+};
+
+
+// A least-squares fit of seconds = constant * complexity_model(...).
+struct ComplexityFit
+{
+	std::string algorithm;
+	double constant = NAN;
+	double r_squared = NAN;
+	size_t points = 0;
+};
+
+
+// Fit the constant of algorithm's complexity_model to its points in
+// timings, by least squares through the origin. r_squared is the share of
+// the variance in seconds that the model explains.
+ComplexityFit fit_complexity(const std::string& algorithm, const std::vector<TimingPoint>& timings)
+{
+	ComplexityFit fit;
+	fit.algorithm = algorithm;
+
+	double xy = 0, xx = 0, y_sum = 0;
+	for (auto& point : timings)
+	{
+		double x = complexity_model(algorithm, point.n, point.total_weight);
+		if (point.algorithm != algorithm || !std::isfinite(x))
+		{
+			continue;
+		}
+		xy += x * point.seconds;
+		xx += x * x;
+		y_sum += point.seconds;
+		fit.points++;
+	}
+	if (fit.points == 0 || xx == 0)
+	{
+		return fit;
+	}
+	fit.constant = xy / xx;
+
+	const double y_mean = y_sum / fit.points;
+	double residual = 0, total = 0;
+	for (auto& point : timings)
+	{
+		double x = complexity_model(algorithm, point.n, point.total_weight);
+		if (point.algorithm != algorithm || !std::isfinite(x))
+		{
+			continue;
+		}
+		residual += (point.seconds - fit.constant * x) * (point.seconds - fit.constant * x);
+		total += (point.seconds - y_mean) * (point.seconds - y_mean);
+	}
+	fit.r_squared = total > 0 ? 1 - residual / total : 1;
+	return fit;
+}
+
+
+// Append the timings in a benchmark CSV to timings. Two layouts are read:
+// tidy files with algorithm, n, W and median_s columns (as written by
+// maxcalorie_benchmark), and scatterplot files with n and seconds columns,
+// whose points are labelled algorithm with capacity total_weight.
+// Returns false when the file cannot be read or has neither layout.
+bool read_timing_csv
+(
+	const std::string& path,
+	const std::string& algorithm,
+	double total_weight,
+	std::vector<TimingPoint>& timings
+)
+{
+	std::ifstream f(path);
+	std::string line;
+	if (!f || !std::getline(f, line))
+	{
+		std::cout << "Failed to read timings; cannot open file: " << path << std::endl;
+		return false;
+	}
+
+	auto split = [](const std::string& text)
+	{
+		std::vector<std::string> fields;
+		std::stringstream ss(text);
+		for (std::string field; std::getline(ss, field, ','); )
+		{
+			fields.push_back(field);
+		}
+		return fields;
+	};
+
+	std::vector<std::string> header = split(line);
+	auto column = [&](const std::string& name)
+	{
+		auto found = std::find(header.begin(), header.end(), name);
+		return found == header.end() ? -1 : int(found - header.begin());
+	};
+
+	int algorithm_column = column("algorithm"), n_column = column("n"), w_column = column("W");
+	int seconds_column = column("median_s") >= 0 ? column("median_s") : column("seconds");
+	if (n_column < 0 || seconds_column < 0 || (algorithm_column >= 0) != (w_column >= 0))
+	{
+		std::cout << "Failed to read timings; unknown layout in " << path << std::endl;
+		return false;
+	}
+
+	while (std::getline(f, line))
+	{
+		std::vector<std::string> fields = split(line);
+		if (int(fields.size()) != int(header.size()))
+		{
+			continue;
+		}
+		TimingPoint point;
+		point.algorithm = algorithm_column >= 0 ? fields[algorithm_column] : algorithm;
+		point.n = std::atoi(fields[n_column].c_str());
+		point.total_weight = w_column >= 0 ? std::atof(fields[w_column].c_str()) : total_weight;
+		point.seconds = std::atof(fields[seconds_column].c_str());
+		timings.push_back(point);
+	}
+	return true;
+}
+
+
+// Runs benchmarks and collects their results.
+class BenchmarkSuite
+{
+	//
+	public:
+
+		explicit BenchmarkSuite(const BenchmarkOptions& options = BenchmarkOptions())
+			:
+			_options(options)
+		{
+			assert(options.warmup >= 0);
+			assert(options.trials > 0);
+
+			if (options.pin_cpu && !pin_to_cpu(options.cpu))
+			{
+				std::cout << "Benchmark: could not pin to a CPU; timings may be noisier" << std::endl;
+			}
+
+			if (options.counters)
+			{
+				_counters.reset(new PerfCounters);
+				if (!_counters->available())
+				{
+					std::cout << "Benchmark: hardware counters are not available; they will read as NaN" << std::endl;
+				}
+			}
+		}
+
+		// Time solve, a callable taking no arguments whose result is kept
+		// alive until the clock stops, as the point (algorithm, n,
+		// total_weight).
+		template <typename Solve>
+		const BenchmarkResult& run
+		(
+			const std::string& algorithm,
+			int n,
+			double total_weight,
+			Solve&& solve
+		)
+		{
+			BenchmarkResult result;
+			result.algorithm = algorithm;
+			result.n = n;
+			result.total_weight = total_weight;
+
+			for (int i = 0; i < _options.warmup; i++)
+			{
+				auto value = solve();
+				do_not_optimize(value);
+			}
+
+			result.samples.reserve(_options.trials);
+			for (int i = 0; i < _options.trials; i++)
+			{
+				if (_counters)
+				{
+					_counters->start();
+				}
+				clobber_memory();
+				Timer timer;
+				auto value = solve();
+				do_not_optimize(value);
+				result.samples.push_back(timer.elapsed());
+				if (_counters)
+				{
+					result.counters.push_back(_counters->stop());
+				}
+			}
+
+			if (_options.memory)
+			{
+				default_solver_scratch().release();
+				MemoryMeter meter;
+				meter.start();
+				{
+					auto value = solve();
+					do_not_optimize(value);
+				}
+				result.memory = meter.stop();
+			}
+
+			summarize_benchmark(result, _options.outlier_iqr_factor);
+			_results.push_back(std::move(result));
+			return _results.back();
+		}
+
+		//
+		const BenchmarkOptions& options() const { return _options; }
+		const std::vector<BenchmarkResult>& results() const { return _results; }
+
+		// One row per (algorithm, n, W) point, with its statistics. In
+		// counters mode, also the median counter values, IPC, and misses per
+		// item-capacity cell; in memory mode, also the memory of one solve.
+		void write_summary_csv(std::ostream& out) const
+		{
+			out << "algorithm,n,W,trials,kept,median_s,p95_s,mean_s,stddev_s,min_s,max_s";
+			if (_counters)
+			{
+				out << ",cycles,instructions,ipc,cache_misses,branch_misses,llc_loads,cache_misses_per_cell,branch_misses_per_cell,llc_loads_per_cell";
+			}
+			if (_options.memory)
+			{
+				out << ",allocations,allocated_bytes,peak_heap_bytes,peak_rss_bytes";
+			}
+			out << std::endl;
+			out << std::fixed << std::setprecision(10);
+			for (auto& result : _results)
+			{
+				out
+					<< result.algorithm << ","
+					<< result.n << ","
+					<< std::defaultfloat << result.total_weight << std::fixed << ","
+					<< result.samples.size() << ","
+					<< result.kept << ","
+					<< result.median << ","
+					<< result.p95 << ","
+					<< result.mean << ","
+					<< result.stddev << ","
+					<< result.min << ","
+					<< result.max
+					;
+				if (_counters)
+				{
+					const PerfCounterValues& c = result.median_counters;
+					out
+						<< "," << c.cycles
+						<< "," << c.instructions
+						<< "," << c.ipc()
+						<< "," << c.cache_misses
+						<< "," << c.branch_misses
+						<< "," << c.llc_loads
+						<< "," << c.cache_misses / result.cells()
+						<< "," << c.branch_misses / result.cells()
+						<< "," << c.llc_loads / result.cells()
+						;
+				}
+				if (_options.memory)
+				{
+					out
+						<< "," << result.memory.allocations
+						<< "," << result.memory.allocated_bytes
+						<< "," << result.memory.peak_heap_bytes
+						<< "," << result.memory.peak_rss_bytes
+						;
+				}
+				out << std::endl;
+			}
+		}
+
+		// One row per trial of every point: the full distribution.
+		void write_samples_csv(std::ostream& out) const
+		{
+			out << "algorithm,n,W,trial,seconds,outlier";
+			if (_counters)
+			{
+				out << ",cycles,instructions,cache_misses,branch_misses,llc_loads";
+			}
+			out << std::endl;
+			out << std::fixed << std::setprecision(10);
+			for (auto& result : _results)
+			{
+				for (size_t i = 0; i < result.samples.size(); i++)
+				{
+					out
+						<< result.algorithm << ","
+						<< result.n << ","
+						<< std::defaultfloat << result.total_weight << std::fixed << ","
+						<< i << ","
+						<< result.samples[i] << ","
+						<< (result.outlier[i] ? 1 : 0)
+						;
+					if (_counters)
+					{
+						const PerfCounterValues& c = result.counters[i];
+						out
+							<< "," << c.cycles
+							<< "," << c.instructions
+							<< "," << c.cache_misses
+							<< "," << c.branch_misses
+							<< "," << c.llc_loads
+							;
+					}
+					out << std::endl;
+				}
+			}
+		}
+
+	//
+	private:
+		BenchmarkOptions _options;
+		std::vector<BenchmarkResult> _results;
+		std::unique_ptr<PerfCounters> _counters;
+};
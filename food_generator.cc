@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// food_generator.cc
+//
+// Write a synthetic food database in the food.csv format.
+//
+// Usage: food_generator [--out PATH] [--n N] [--seed SEED]
+//	[--min-weight W] [--max-weight W] [--weights uniform|log-uniform]
+//	[--correlation uncorrelated|weak|strong|subset-sum]
+//	[--duplicates RATE]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "food_generator.hh"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  FoodGeneratorOptions options;
+  string out_path = "generated_food.csv";
+
+  for (int i = 1; i < argc; i += 2)
+  {
+    string flag = argv[i];
+    if (i + 1 >= argc)
+    {
+      cout << "Missing value for " << flag << endl;
+      return 1;
+    }
+    string value = argv[i + 1];
+
+    if (flag == "--out") out_path = value;
+    else if (flag == "--n") options.n = strtoull(value.c_str(), nullptr, 10);
+    else if (flag == "--seed") options.seed = strtoull(value.c_str(), nullptr, 10);
+    else if (flag == "--min-weight") options.min_weight = atoi(value.c_str());
+    else if (flag == "--max-weight") options.max_weight = atoi(value.c_str());
+    else if (flag == "--duplicates") options.duplicate_rate = atof(value.c_str());
+    else if (flag == "--weights" && value == "uniform") options.weight_distribution = FoodWeightDistribution::UNIFORM;
+    else if (flag == "--weights" && value == "log-uniform") options.weight_distribution = FoodWeightDistribution::LOG_UNIFORM;
+    else if (flag == "--correlation" && parse_food_correlation(value, options.correlation)) { }
+    else
+    {
+      cout << "Invalid option " << flag << " " << value << endl;
+      return 1;
+    }
+  }
+
+  if (options.min_weight < 1 || options.max_weight < options.min_weight || options.duplicate_rate < 0 || options.duplicate_rate > 1)
+  {
+    cout << "Invalid generator options" << endl;
+    return 1;
+  }
+
+  ofstream out(out_path);
+  if (!out)
+  {
+    cout << "Cannot open " << out_path << endl;
+    return 1;
+  }
+  write_generated_food_csv(options, out);
+  out.close();
+
+  cout << "Wrote " << options.n << " foods to " << out_path << endl;
+  return 0;
+}
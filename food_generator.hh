@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+// food_generator.hh
+//
+// Deterministic generator of synthetic food databases in the food.csv
+// format, drawn from the classic hard knapsack instance families.
+//
+// The same options (including the seed) always produce the same file, on
+// every platform: the generator uses its own random number generator and
+// conversions instead of the implementation-defined std distributions.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "maxcalorie.hh"
+
+
+// How calories relate to weight, for weights w drawn from
+// [min_weight, max_weight] and R = max_weight:
+//	UNCORRELATED		calories uniform in [1, R]
+//	WEAKLY_CORRELATED	calories uniform in [w - R/10, w + R/10], at least 1
+//	STRONGLY_CORRELATED	calories = w + R/10
+//	SUBSET_SUM		calories = w
+enum class FoodCorrelation
+{
+	UNCORRELATED,
+	WEAKLY_CORRELATED,
+	STRONGLY_CORRELATED,
+	SUBSET_SUM
+};
+
+// How weights are drawn from [min_weight, max_weight].
+enum class FoodWeightDistribution
+{
+	// Every integer weight equally likely.
+	UNIFORM,
+	// Uniform in log(weight): many light items, few heavy ones.
+	LOG_UNIFORM
+};
+
+
+// Parameters of a generated database.
+struct FoodGeneratorOptions
+{
+	uint64_t seed = 1;
+	size_t n = 1000;
+
+	// Weights are integers in [min_weight, max_weight].
+	int min_weight = 1;
+	int max_weight = 100;
+	FoodWeightDistribution weight_distribution = FoodWeightDistribution::UNIFORM;
+
+	FoodCorrelation correlation = FoodCorrelation::UNCORRELATED;
+
+	// Probability that a row repeats an earlier row exactly.
+	double duplicate_rate = 0;
+};
+
+
+// Parse the command-line spelling of a FoodCorrelation ("uncorrelated",
+// "weak", "strong", "subset-sum"). Returns false for an unknown name.
+bool parse_food_correlation(const std::string& name, FoodCorrelation& correlation)
+{
+	if (name == "uncorrelated") correlation = FoodCorrelation::UNCORRELATED;
+	else if (name == "weak") correlation = FoodCorrelation::WEAKLY_CORRELATED;
+	else if (name == "strong") correlation = FoodCorrelation::STRONGLY_CORRELATED;
+	else if (name == "subset-sum") correlation = FoodCorrelation::SUBSET_SUM;
+	else return false;
+	return true;
+}
+
+
+// SplitMix64: a small, fast generator whose output is fully specified.
+class FoodRandom
+{
+	//
+	public:
+		explicit FoodRandom(uint64_t seed) : _state(seed) { }
+
+		uint64_t next()
+		{
+			uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		// Uniform in [0, 1).
+		double uniform()
+		{
+			return (next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+		// Uniform integer in [low, high].
+		int64_t between(int64_t low, int64_t high)
+		{
+			return low + int64_t(uniform() * double(high - low + 1));
+		}
+
+	//
+	private:
+		uint64_t _state;
+};
+
+
+// One generated row.
+struct GeneratedFood
+{
+	std::string description;
+	int weight;
+	double calories;
+};
+
+
+// Generate the rows of a synthetic database.
+std::vector<GeneratedFood> generate_foods(const FoodGeneratorOptions& options)
+{
+	assert(options.min_weight > 0 && options.min_weight <= options.max_weight);
+
+	static const char* const adjectives[] = {
+		"refried", "spicy", "Idaho", "MSG-free", "smoked", "roasted", "fresh",
+		"canned", "organic", "frozen", "whole", "sweet", "pickled", "toasted"
+	};
+	static const char* const foods[] = {
+		"beans", "potatoes", "pork", "corn", "bread", "rice", "chicken breast",
+		"pasta", "tuna", "oats", "lentils", "peanuts", "apples", "cheese"
+	};
+	const size_t adjective_count = sizeof(adjectives) / sizeof(adjectives[0]);
+	const size_t food_count = sizeof(foods) / sizeof(foods[0]);
+
+	FoodRandom random(options.seed);
+	const int R = options.max_weight;
+
+	std::vector<GeneratedFood> result;
+	result.reserve(options.n);
+	for (size_t i = 0; i < options.n; i++)
+	{
+		if (!result.empty() && random.uniform() < options.duplicate_rate)
+		{
+			result.push_back(result[random.between(0, result.size() - 1)]);
+			continue;
+		}
+
+		GeneratedFood food;
+		food.description =
+			std::string(adjectives[random.between(0, adjective_count - 1)]) + " "
+			+ adjectives[random.between(0, adjective_count - 1)] + " "
+			+ foods[random.between(0, food_count - 1)]
+			;
+
+		if (options.weight_distribution == FoodWeightDistribution::LOG_UNIFORM)
+		{
+			double log_low = std::log(double(options.min_weight)), log_high = std::log(options.max_weight + 1.0);
+			food.weight = std::min(options.max_weight, int(std::exp(log_low + random.uniform() * (log_high - log_low))));
+		}
+		else
+		{
+			food.weight = random.between(options.min_weight, options.max_weight);
+		}
+
+		switch (options.correlation)
+		{
+			case FoodCorrelation::UNCORRELATED:
+				food.calories = random.between(1, R);
+				break;
+			case FoodCorrelation::WEAKLY_CORRELATED:
+				food.calories = std::max<int64_t>(1, random.between(food.weight - R / 10, food.weight + R / 10));
+				break;
+			case FoodCorrelation::STRONGLY_CORRELATED:
+				food.calories = food.weight + R / 10;
+				break;
+			case FoodCorrelation::SUBSET_SUM:
+				food.calories = food.weight;
+				break;
+		}
+
+		result.push_back(food);
+	}
+	return result;
+}
+
+
+// Write a synthetic database in the food.csv format ('^'-delimited, with
+// the same header row) to out. Calories are written with enough digits to
+// read back exactly, as generate_food_vector has them.
+void write_generated_food_csv(const FoodGeneratorOptions& options, std::ostream& out)
+{
+	const std::streamsize precision = out.precision(17);
+	out << "Item^Weight^foodCalories" << "\n";
+	for (auto& food : generate_foods(options))
+	{
+		out << food.description << "^" << food.weight << "^" << food.calories << "\n";
+	}
+	out.precision(precision);
+}
+
+
+// Generate a synthetic database directly as a FoodVector, with the same
+// items load_food_database would read from write_generated_food_csv's file.
+std::unique_ptr<FoodVector> generate_food_vector(const FoodGeneratorOptions& options)
+{
+	std::unique_ptr<FoodVector> result(new FoodVector);
+	auto arena = FoodArena::create();
+	for (auto& food : generate_foods(options))
+	{
+		result->push_back(arena->make_item(food.description, food.weight, food.calories));
+	}
+	return result;
+}
@@ -0,0 +1,597 @@
+////////////////////////////////////////////////////////////////////////////////
+// foodtable.hh
+//
+// Columnar, read-only view of a food database, and a versioned binary
+// snapshot format that can be memory-mapped instead of parsing food.csv.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "maxcalorie.hh"
+
+
+// Snapshot file layout (native byte order):
+//
+//	FoodSnapshotHeader
+//	double   weights[count]
+//	double   calories[count]
+//	uint64_t description_offsets[count + 1]	(into the blob)
+//	char     description_blob[blob_size]
+//
+// The checksum covers every byte after the header.
+const char FOOD_SNAPSHOT_MAGIC[8] = { 'F', 'O', 'O', 'D', 'S', 'N', 'A', 'P' };
+const uint32_t FOOD_SNAPSHOT_VERSION = 1;
+
+struct FoodSnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint64_t count;
+	uint64_t blob_size;
+
+	// Size and modification time of the CSV this snapshot was built from;
+	// the snapshot is stale when either differs.
+	uint64_t source_size;
+	int64_t source_mtime_ns;
+
+	uint64_t checksum;
+	uint64_t reserved;
+};
+
+static_assert(sizeof(FoodSnapshotHeader) == 64, "snapshot header must stay 64 bytes");
+
+
+// 64-bit FNV-1a hash of size bytes at data.
+uint64_t fnv1a_64(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+// A food database stored column by column, in exactly the snapshot layout,
+// so it can live either in an owned buffer or in a read-only file mapping.
+class FoodTable
+{
+	//
+	public:
+
+		// An empty table.
+		FoodTable() { }
+
+		// Build a table holding a copy of every item in foods.
+		static FoodTable from_food_vector(const FoodVector& foods)
+		{
+			uint64_t blob_size = 0;
+			for (auto& food : foods)
+			{
+				blob_size += food->description().size();
+			}
+
+			const uint64_t count = foods.size();
+			const size_t total_size =
+				sizeof(FoodSnapshotHeader)
+				+ 2 * count * sizeof(double)
+				+ (count + 1) * sizeof(uint64_t)
+				+ blob_size
+				;
+
+			auto buffer = std::make_shared<std::vector<char>>(total_size);
+			char* data = buffer->data();
+
+			FoodSnapshotHeader header;
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, FOOD_SNAPSHOT_MAGIC, sizeof(header.magic));
+			header.version = FOOD_SNAPSHOT_VERSION;
+			header.header_size = sizeof(FoodSnapshotHeader);
+			header.count = count;
+			header.blob_size = blob_size;
+
+			FoodTable table;
+			table.bind(data, header);
+
+			double* weights = const_cast<double*>(table._weights);
+			double* calories = const_cast<double*>(table._calories);
+			uint64_t* offsets = const_cast<uint64_t*>(table._offsets);
+			char* blob = const_cast<char*>(table._blob);
+
+			uint64_t offset = 0;
+			for (uint64_t i = 0; i < count; i++)
+			{
+				std::string_view description = foods[i]->description();
+				weights[i] = foods[i]->weight();
+				calories[i] = foods[i]->foodCalories();
+				offsets[i] = offset;
+				std::memcpy(blob + offset, description.data(), description.size());
+				offset += description.size();
+			}
+			offsets[count] = offset;
+
+			header.checksum = fnv1a_64(data + sizeof(header), total_size - sizeof(header));
+			std::memcpy(data, &header, sizeof(header));
+
+			table._storage = buffer;
+			table._bytes = total_size;
+			return table;
+		}
+
+		//
+		size_t size() const { return _count; }
+		bool empty() const { return _count == 0; }
+
+		// Columns; each has size() entries.
+		const double* weights() const { return _weights; }
+		const double* calories() const { return _calories; }
+
+		//
+		double weight(size_t i) const { return _weights[i]; }
+		double foodCalories(size_t i) const { return _calories[i]; }
+		std::string_view description(size_t i) const
+		{
+			return std::string_view(_blob + _offsets[i], _offsets[i + 1] - _offsets[i]);
+		}
+
+		// Materialize the table as FoodItem objects, allocated in one
+		// FoodArena with interned descriptions, as load_food_database does.
+		std::unique_ptr<FoodVector> to_food_vector() const
+		{
+			std::unique_ptr<FoodVector> result(new FoodVector);
+			result->reserve(_count);
+			auto arena = FoodArena::create(
+				_count * (sizeof(FoodItem) + 4 * sizeof(void*)) + 1
+			);
+			for (size_t i = 0; i < _count; i++)
+			{
+				result->push_back(arena->make_item(description(i), _weights[i], _calories[i]));
+			}
+			return result;
+		}
+
+		// The full serialized image (header included), size_in_bytes() long.
+		const char* data() const { return _data; }
+		size_t size_in_bytes() const { return _bytes; }
+
+		// Wrap an existing serialized image, keeping storage alive for as long
+		// as the table (or a copy of it) exists. Returns false when the image
+		// is truncated, of another version, fails its checksum, or has
+		// description offsets that leave the blob.
+		bool attach(std::shared_ptr<const void> storage, const char* data, size_t bytes)
+		{
+			FoodSnapshotHeader header;
+			if (bytes < sizeof(header))
+			{
+				return false;
+			}
+			std::memcpy(&header, data, sizeof(header));
+
+			if (
+				std::memcmp(header.magic, FOOD_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+				|| header.version != FOOD_SNAPSHOT_VERSION
+				|| header.header_size != sizeof(FoodSnapshotHeader)
+			)
+			{
+				return false;
+			}
+
+			// Each item takes 24 bytes of columns, so a count above bytes / 24
+			// is corrupt, and checking it first keeps the sizes from wrapping
+			const uint64_t per_item = 2 * sizeof(double) + sizeof(uint64_t);
+			if (header.count > (bytes - sizeof(header)) / per_item)
+			{
+				return false;
+			}
+			const uint64_t columns_size = sizeof(FoodSnapshotHeader) + header.count * per_item + sizeof(uint64_t);
+			if (
+				columns_size > bytes
+				|| header.blob_size != bytes - columns_size
+				|| fnv1a_64(data + sizeof(header), bytes - sizeof(header)) != header.checksum
+			)
+			{
+				return false;
+			}
+
+			// description(i) trusts the offsets, so check them once here
+			const uint64_t* offsets = reinterpret_cast<const uint64_t*>(
+				data + sizeof(FoodSnapshotHeader) + 2 * header.count * sizeof(double)
+			);
+			for (size_t i = 0; i < header.count; i++)
+			{
+				if (offsets[i] > offsets[i + 1])
+				{
+					return false;
+				}
+			}
+			if (offsets[header.count] > header.blob_size)
+			{
+				return false;
+			}
+
+			bind(data, header);
+			_storage = storage;
+			_bytes = bytes;
+			return true;
+		}
+
+	//
+	private:
+
+		// Point the column pointers into the image at data.
+		void bind(const char* data, const FoodSnapshotHeader& header)
+		{
+			_data = data;
+			_count = header.count;
+			_weights = reinterpret_cast<const double*>(data + sizeof(FoodSnapshotHeader));
+			_calories = _weights + _count;
+			_offsets = reinterpret_cast<const uint64_t*>(_calories + _count);
+			_blob = reinterpret_cast<const char*>(_offsets + _count + 1);
+		}
+
+		// Owner of the bytes: a heap buffer or a file mapping.
+		std::shared_ptr<const void> _storage;
+
+		const char* _data = nullptr;
+		size_t _bytes = 0;
+		size_t _count = 0;
+		const double* _weights = nullptr;
+		const double* _calories = nullptr;
+		const uint64_t* _offsets = nullptr;
+		const char* _blob = nullptr;
+};
+
+
+// Read the size and modification time of path. Returns false when the
+// file cannot be stat'ed.
+bool food_source_stamp(const std::string& path, uint64_t& size, int64_t& mtime_ns)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+	{
+		return false;
+	}
+	size = st.st_size;
+	mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+
+// Write table to path as a snapshot of the CSV file at source_path, whose
+// stamp (see food_source_stamp) was source_size and source_mtime_ns when
+// table was parsed from it; take the stamp before parsing. The file is
+// written under a temporary name and renamed into place, so readers never
+// see a partial snapshot. Returns false on I/O error, and without writing
+// when the source's stamp has changed since, as the table may not match
+// it.
+bool write_food_snapshot
+(
+	const FoodTable& table,
+	const std::string& path,
+	const std::string& source_path,
+	uint64_t source_size,
+	int64_t source_mtime_ns
+)
+{
+	FoodSnapshotHeader header;
+	std::memcpy(&header, table.data(), sizeof(header));
+	header.source_size = source_size;
+	header.source_mtime_ns = source_mtime_ns;
+
+	const std::string temp_path = path + ".tmp";
+	std::ofstream f(temp_path, std::ios::binary | std::ios::trunc);
+	if (!f)
+	{
+		std::cout << "Failed to write food snapshot; cannot open file: " << temp_path << std::endl;
+		return false;
+	}
+
+	f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	f.write(table.data() + sizeof(header), table.size_in_bytes() - sizeof(header));
+	f.close();
+
+	uint64_t size_now;
+	int64_t mtime_now;
+	if (
+		! food_source_stamp(source_path, size_now, mtime_now)
+		|| size_now != source_size
+		|| mtime_now != source_mtime_ns
+	)
+	{
+		std::cout << "Not writing food snapshot; source changed while loading: " << source_path << std::endl;
+		std::remove(temp_path.c_str());
+		return false;
+	}
+
+	if ( ! f || std::rename(temp_path.c_str(), path.c_str()) != 0 )
+	{
+		std::cout << "Failed to write food snapshot: " << path << std::endl;
+		std::remove(temp_path.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+// Memory-map the snapshot at path. Returns nullptr when the snapshot is
+// missing, corrupt, or stale with respect to the CSV at source_path.
+std::unique_ptr<FoodTable> map_food_snapshot
+(
+	const std::string& path,
+	const std::string& source_path
+)
+{
+	std::unique_ptr<FoodTable> failure(nullptr);
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return failure;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(FoodSnapshotHeader))
+	{
+		close(fd);
+		return failure;
+	}
+
+	const size_t bytes = st.st_size;
+	void* mapping = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		return failure;
+	}
+
+	std::shared_ptr<const void> storage(
+		mapping,
+		[bytes](const void* p) { munmap(const_cast<void*>(p), bytes); }
+	);
+
+	FoodSnapshotHeader header;
+	std::memcpy(&header, mapping, sizeof(header));
+
+	uint64_t source_size;
+	int64_t source_mtime_ns;
+	if (
+		! food_source_stamp(source_path, source_size, source_mtime_ns)
+		|| header.source_size != source_size
+		|| header.source_mtime_ns != source_mtime_ns
+	)
+	{
+		return failure;
+	}
+
+	std::unique_ptr<FoodTable> table(new FoodTable);
+	if ( ! table->attach(storage, static_cast<const char*>(mapping), bytes) )
+	{
+		std::cout << "Ignoring corrupt food snapshot: " << path << std::endl;
+		return failure;
+	}
+
+	return table;
+}
+
+
+// Load the food database at csv_path as a table, from the snapshot at
+// snapshot_path when it is current, otherwise by parsing the CSV and
+// rewriting the snapshot. Returns nullptr when the CSV cannot be loaded.
+std::unique_ptr<FoodTable> load_food_table
+(
+	const std::string& csv_path,
+	const std::string& snapshot_path
+)
+{
+	auto table = map_food_snapshot(snapshot_path, csv_path);
+	if (table)
+	{
+		return table;
+	}
+
+	// Stamp the CSV before parsing it, so that a change made meanwhile
+	// leaves the snapshot unwritten instead of marking it current
+	uint64_t source_size;
+	int64_t source_mtime_ns;
+	const bool stamped = food_source_stamp(csv_path, source_size, source_mtime_ns);
+
+	auto foods = load_food_database(csv_path);
+	if (!foods)
+	{
+		return nullptr;
+	}
+
+	table.reset(new FoodTable(FoodTable::from_food_vector(*foods)));
+	if (stamped)
+	{
+		write_food_snapshot(*table, snapshot_path, csv_path, source_size, source_mtime_ns);
+	}
+	return table;
+}
+
+
+// As load_food_database, but going through the snapshot at snapshot_path.
+std::unique_ptr<FoodVector> load_food_database_cached
+(
+	const std::string& csv_path,
+	const std::string& snapshot_path
+)
+{
+	auto table = load_food_table(csv_path, snapshot_path);
+	if (!table)
+	{
+		return nullptr;
+	}
+	return table->to_food_vector();
+}
+
+
+// Criteria for filter_food_table. An item matches when its calories pass
+// filter_food_vector's test (positive and within [min_calories,
+// max_calories]) and its weight is within [min_weight, max_weight].
+// All bounds are inclusive.
+struct FoodPredicate
+{
+	double min_calories = -HUGE_VAL;
+	double max_calories = HUGE_VAL;
+	double min_weight = -HUGE_VAL;
+	double max_weight = HUGE_VAL;
+};
+
+
+// Portable implementation of filter_food_table.
+std::vector<uint32_t> filter_food_table_scalar
+(
+	const FoodTable& table,
+	const FoodPredicate& predicate,
+	size_t total_size
+)
+{
+	std::vector<uint32_t> result;
+	result.reserve(std::min(total_size, table.size()));
+
+	const double* weights = table.weights();
+	const double* calories = table.calories();
+	for (size_t i = 0; i < table.size() && result.size() < total_size; i++)
+	{
+		if (
+			food_calories_match(calories[i], predicate.min_calories, predicate.max_calories)
+			&& weights[i] >= predicate.min_weight
+			&& weights[i] <= predicate.max_weight
+		)
+		{
+			result.push_back(i);
+		}
+	}
+	return result;
+}
+
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+#include <immintrin.h>
+
+#define FOODTABLE_HAVE_AVX2 1
+
+// AVX2 implementation of filter_food_table: tests four rows per
+// instruction and compacts the matches from the comparison mask. The
+// ordered comparisons reject NaN exactly as the scalar code does.
+// Only call this when the CPU supports AVX2.
+__attribute__((target("avx2")))
+std::vector<uint32_t> filter_food_table_avx2
+(
+	const FoodTable& table,
+	const FoodPredicate& predicate,
+	size_t total_size
+)
+{
+	std::vector<uint32_t> result;
+	result.reserve(std::min(total_size, table.size()));
+	if (total_size == 0)
+	{
+		return result;
+	}
+
+	const double* weights = table.weights();
+	const double* calories = table.calories();
+	const size_t n = table.size();
+
+	const __m256d
+		zero = _mm256_setzero_pd(),
+		min_calories = _mm256_set1_pd(predicate.min_calories),
+		max_calories = _mm256_set1_pd(predicate.max_calories),
+		min_weight = _mm256_set1_pd(predicate.min_weight),
+		max_weight = _mm256_set1_pd(predicate.max_weight)
+		;
+
+	size_t i = 0;
+	for ( ; i + 4 <= n; i += 4)
+	{
+		__m256d c = _mm256_loadu_pd(calories + i);
+		__m256d w = _mm256_loadu_pd(weights + i);
+
+		__m256d match = _mm256_and_pd(
+			_mm256_and_pd(
+				_mm256_cmp_pd(c, zero, _CMP_GT_OQ),
+				_mm256_and_pd(
+					_mm256_cmp_pd(c, min_calories, _CMP_GE_OQ),
+					_mm256_cmp_pd(c, max_calories, _CMP_LE_OQ)
+				)
+			),
+			_mm256_and_pd(
+				_mm256_cmp_pd(w, min_weight, _CMP_GE_OQ),
+				_mm256_cmp_pd(w, max_weight, _CMP_LE_OQ)
+			)
+		);
+
+		for (unsigned bits = _mm256_movemask_pd(match); bits != 0; bits &= bits - 1)
+		{
+			result.push_back(i + __builtin_ctz(bits));
+			if (result.size() == total_size)
+			{
+				return result;
+			}
+		}
+	}
+
+	for ( ; i < n && result.size() < total_size; i++)
+	{
+		if (
+			food_calories_match(calories[i], predicate.min_calories, predicate.max_calories)
+			&& weights[i] >= predicate.min_weight
+			&& weights[i] <= predicate.max_weight
+		)
+		{
+			result.push_back(i);
+		}
+	}
+	return result;
+}
+
+#endif
+
+
+// Positions, in ascending order, of the first total_size rows of table that
+// match predicate. Uses AVX2 when the CPU has it.
+// For a table built from a FoodVector (or materialized with
+// to_food_vector), the positions index that vector too, so they can back a
+// FoodView.
+std::vector<uint32_t> filter_food_table
+(
+	const FoodTable& table,
+	const FoodPredicate& predicate,
+	size_t total_size
+)
+{
+#ifdef FOODTABLE_HAVE_AVX2
+	static const bool have_avx2 = __builtin_cpu_supports("avx2");
+	if (have_avx2)
+	{
+		return filter_food_table_avx2(table, predicate, total_size);
+	}
+#endif
+	return filter_food_table_scalar(table, predicate, total_size);
+}
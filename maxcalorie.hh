@@ -10,17 +10,42 @@
 #pragma once
 
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <list>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 
+// Tag for constructing a FoodItem whose description string is owned
+// elsewhere (by a FoodArena) and outlives the item. id is the description's
+// interned ID within its FoodArena, or 0 when it was not interned.
+struct BorrowedDescription
+{
+	const std::string* text;
+	uint32_t id;
+};
+
+
 // One food item available for purchase.
 class FoodItem
 {
@@ -35,7 +60,7 @@ class FoodItem
 			double calories
 		)
 			:
-			_description(description),
+			_description(std::make_shared<const std::string>(description)),
 			_weight_ounces(weight_ounces),
 			_calories(calories)
 		{
@@ -43,10 +68,44 @@ class FoodItem
 			assert(weight_ounces > 0);
 		}
 		
+		// Construct an item that refers to, rather than copies, its
+		// description.
+		FoodItem
+		(
+			BorrowedDescription description,
+			double weight_ounces,
+			double calories
+		)
+			:
+			// Aliasing an empty owner: a plain pointer, with no count to update
+			_description(std::shared_ptr<const void>(), description.text),
+			_description_id(description.id),
+			_weight_ounces(weight_ounces),
+			_calories(calories)
+		{
+			assert(description.text && !description.text->empty());
+			assert(weight_ounces > 0);
+		}
+		
 		//
-		const std::string& description() const { return _description; }
+		const std::string& description() const { return *_description; }
+		
+		// The description without committing to how it is stored.
+		std::string_view description_view() const { return description(); }
 		double weight() const { return _weight_ounces; }
 		double foodCalories() const { return _calories; }
+		
+		// Interned description ID, unique per distinct description within
+		// the database (FoodArena) this item was loaded into; 0 when the
+		// description is not interned.
+		uint32_t description_id() const { return _description_id; }
+		
+		// True when both items have the same description. Items interned
+		// together share storage, so this is usually a pointer compare.
+		bool same_description(const FoodItem& other) const
+		{
+			return _description == other._description || *_description == *other._description;
+		}
 	
 	//
 	private:
@@ -54,7 +113,9 @@ class FoodItem
 	return (a > b) ? a : b;
 }
 		// Human-readable description of the food, e.g. "spicy chicken breast". Must be non-empty.
-		std::string _description;
+		// Shared by copies of the item, or, when borrowed, not owned at all.
+		std::shared_ptr<const std::string> _description;
+		uint32_t _description_id = 0;
 		
 		// Food weight, in ounces; Must be positive
 		double _weight_ounces;
@@ -68,89 +129,586 @@ class FoodItem
 typedef std::vector<std::shared_ptr<FoodItem>> FoodVector;
 
 
+// Non-owning, read-only view of some of the items of a FoodVector: either
+// its first items (a prefix), or the items at a list of positions. Views
+// are cheap to copy; a prefix view allocates nothing, and sub-views of a
+// positional view share its position list.
+// The source FoodVector must outlive every view of it.
+class FoodView
+{
+	//
+	public:
+		
+		// View of all of source.
+		FoodView(const FoodVector& source)
+			:
+			_source(&source),
+			_size(source.size())
+		{ }
+		
+		// View of the first prefix_length items of source.
+		FoodView(const FoodVector& source, size_t prefix_length)
+			:
+			_source(&source),
+			_size(prefix_length)
+		{
+			assert(prefix_length <= source.size());
+		}
+		
+		// View of the items of source at the first length positions.
+		FoodView
+		(
+			const FoodVector& source,
+			std::shared_ptr<const std::vector<uint32_t>> positions,
+			size_t length
+		)
+			:
+			_source(&source),
+			_positions(std::move(positions)),
+			_size(length)
+		{
+			assert(length <= _positions->size());
+		}
+		
+		//
+		size_t size() const { return _size; }
+		bool empty() const { return _size == 0; }
+		const FoodVector& source() const { return *_source; }
+		
+		// True when this view is the first size() items of source().
+		bool is_prefix() const { return !_positions; }
+		
+		// Position in source() of the i-th item of the view.
+		size_t position(size_t i) const { return _positions ? (*_positions)[i] : i; }
+		
+		const std::shared_ptr<FoodItem>& operator[](size_t i) const
+		{
+			return (*_source)[position(i)];
+		}
+		
+		// The first length items of this view.
+		FoodView prefix(size_t length) const
+		{
+			assert(length <= _size);
+			FoodView result(*this);
+			result._size = length;
+			return result;
+		}
+		
+		// Copy the viewed items into a new FoodVector.
+		std::unique_ptr<FoodVector> to_food_vector() const
+		{
+			std::unique_ptr<FoodVector> result(new FoodVector);
+			result->reserve(_size);
+			for (size_t i = 0; i < _size; i++)
+			{
+				result->push_back((*this)[i]);
+			}
+			return result;
+		}
+	
+	//
+	private:
+		const FoodVector* _source;
+		std::shared_ptr<const std::vector<uint32_t>> _positions;
+		size_t _size;
+};
+
+
+// Monotonic arena that owns the FoodItem objects (and their descriptions)
+// of one food database. Items are allocated with their shared_ptr control
+// blocks in a single bump-pointer allocation, and every item keeps the
+// arena alive, so the arena is freed in one step when the last item of the
+// database is released.
+// Descriptions are interned: items with equal descriptions share one copy
+// and one description ID. The copies are std::strings, so that
+// FoodItem::description() can return them, and keep their characters on
+// the heap; only the intern table's nodes come from the arena.
+// Allocation is not thread-safe.
+class FoodArena : public std::enable_shared_from_this<FoodArena>
+{
+	//
+	public:
+		
+		// Standard allocator that carves objects out of a FoodArena, and
+		// holds a reference to it.
+		template <typename T>
+		class Allocator
+		{
+			//
+			public:
+				typedef T value_type;
+				
+				explicit Allocator(std::shared_ptr<FoodArena> arena) : _arena(std::move(arena)) { }
+				
+				template <typename U>
+				Allocator(const Allocator<U>& other) : _arena(other.arena()) { }
+				
+				T* allocate(size_t n)
+				{
+					return static_cast<T*>(_arena->_resource.allocate(n * sizeof(T), alignof(T)));
+				}
+				
+				// Memory is reclaimed only when the whole arena is.
+				void deallocate(T*, size_t) { }
+				
+				const std::shared_ptr<FoodArena>& arena() const { return _arena; }
+				
+				template <typename U>
+				bool operator==(const Allocator<U>& other) const { return _arena == other.arena(); }
+				template <typename U>
+				bool operator!=(const Allocator<U>& other) const { return _arena != other.arena(); }
+			
+			//
+			private:
+				std::shared_ptr<FoodArena> _arena;
+		};
+		
+		// Arenas must be owned by a shared_ptr; use create().
+		static std::shared_ptr<FoodArena> create(size_t initial_bytes = 64 * 1024)
+		{
+			return std::shared_ptr<FoodArena>(new FoodArena(initial_bytes));
+		}
+		
+		// Return the interned copy of text, copying it the first time it is
+		// seen. IDs count up from 1.
+		BorrowedDescription intern(std::string_view text)
+		{
+			auto found = _interned.find(text);
+			if (found != _interned.end())
+			{
+				return BorrowedDescription{ &_strings[found->second - 1], found->second };
+			}
+			
+			_strings.emplace_back(text);
+			uint32_t id = _strings.size();
+			_interned.emplace(std::string_view(_strings.back()), id);
+			return BorrowedDescription{ &_strings.back(), id };
+		}
+		
+		// Number of distinct descriptions interned so far.
+		size_t interned_count() const { return _interned.size(); }
+		
+		// Create a food item in the arena, with an interned description.
+		std::shared_ptr<FoodItem> make_item
+		(
+			std::string_view description,
+			double weight_ounces,
+			double calories
+		)
+		{
+			return std::allocate_shared<FoodItem>(
+				Allocator<FoodItem>(shared_from_this()),
+				intern(description),
+				weight_ounces,
+				calories
+			);
+		}
+	
+	//
+	private:
+		explicit FoodArena(size_t initial_bytes) : _resource(initial_bytes), _interned(&_resource) { }
+		
+		std::pmr::monotonic_buffer_resource _resource;
+		
+		// Interned descriptions, in ID order; a deque so that items can
+		// refer to them while more are added.
+		std::deque<std::string> _strings;
+		
+		// Interned descriptions (pointing into _strings) and their IDs.
+		std::pmr::unordered_map<std::string_view, uint32_t> _interned;
+};
+
+
+// Reusable scratch memory for the solvers. Each solve opens a Session and
+// allocates its tables and buffers from the session's memory(); the buffer
+// kept between solves grows to the previous high-water mark (up to
+// MAX_RETAINED_BYTES), so repeated solves of similar size do not touch the
+// heap at all.
+// A SolverScratch must not be shared between threads.
+class SolverScratch
+{
+	//
+	public:
+		
+		// Most memory kept between solves; a larger solve takes the rest
+		// from the heap and returns it when it finishes.
+		static constexpr size_t MAX_RETAINED_BYTES = size_t(16) << 20;
+		
+		SolverScratch() { }
+		SolverScratch(const SolverScratch&) = delete;
+		SolverScratch& operator=(const SolverScratch&) = delete;
+		
+		// One solve's use of the scratch. Ending the session discards its
+		// allocations and returns whatever the buffer could not hold to the
+		// heap.
+		// Sessions may nest, as when a sweep's visit callback runs another
+		// solve on the same thread: a nested session allocates from the heap
+		// and leaves the outer session's memory alone.
+		class Session
+		{
+			//
+			public:
+				explicit Session(SolverScratch& scratch) : _scratch(scratch), _nested(scratch._in_use)
+				{
+					if (_nested)
+					{
+						_own.emplace(std::pmr::new_delete_resource());
+					}
+					else
+					{
+						_scratch.begin();
+					}
+				}
+				
+				~Session()
+				{
+					if (!_nested)
+					{
+						_scratch.end();
+					}
+				}
+				
+				Session(const Session&) = delete;
+				Session& operator=(const Session&) = delete;
+				
+				std::pmr::memory_resource* memory()
+				{
+					return _nested ? &*_own : &*_scratch._resource;
+				}
+			
+			//
+			private:
+				SolverScratch& _scratch;
+				const bool _nested;
+				std::optional<std::pmr::monotonic_buffer_resource> _own;
+		};
+		
+		// Bytes kept between solves.
+		size_t capacity() const { return _capacity; }
+		
+		// Return all memory to the heap; the next solve starts from nothing.
+		void release()
+		{
+			assert(!_in_use);
+			_buffer.reset();
+			_capacity = 0;
+			_wanted = 0;
+		}
+	
+	//
+	private:
+		void begin()
+		{
+			_in_use = true;
+			const size_t wanted = std::min(_wanted, MAX_RETAINED_BYTES);
+			if (wanted != _capacity)
+			{
+				_buffer.reset(wanted ? new std::max_align_t[(wanted + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)] : nullptr);
+				_capacity = wanted;
+			}
+			
+			if (_capacity)
+			{
+				_resource.emplace(_buffer.get(), _capacity, &_upstream);
+			}
+			else
+			{
+				_resource.emplace(&_upstream);
+			}
+		}
+		
+		void end()
+		{
+			_wanted = _capacity + _upstream.spilled;
+			_resource.reset();
+			_upstream.spilled = 0;
+			_in_use = false;
+		}
+		
+		// Heap resource that tallies what the buffer could not serve.
+		class SpillCounter : public std::pmr::memory_resource
+		{
+			//
+			public:
+				size_t spilled = 0;
+			
+			//
+			private:
+				void* do_allocate(size_t bytes, size_t alignment) override
+				{
+					spilled += bytes;
+					return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+				}
+				void do_deallocate(void* p, size_t bytes, size_t alignment) override
+				{
+					std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+				}
+				bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+				{
+					return this == &other;
+				}
+		};
+		
+		std::unique_ptr<std::max_align_t[]> _buffer;
+		size_t _capacity = 0;
+		
+		// High-water mark of the last solve.
+		size_t _wanted = 0;
+		bool _in_use = false;
+		
+		SpillCounter _upstream;
+		std::optional<std::pmr::monotonic_buffer_resource> _resource;
+};
+
+
+// The calling thread's SolverScratch, used by the solver overloads that do
+// not take one explicitly.
+SolverScratch& default_solver_scratch()
+{
+	thread_local SolverScratch scratch;
+	return scratch;
+}
+
+
+// One valid row of the food database, before it becomes a FoodItem.
+struct FoodRow
+{
+	std::string_view description;
+	double weight_ounces;
+	double calories;
+};
+
+
+// One newline-aligned slice of the food database text, parsed by a single
+// worker thread into its own buffer.
+struct FoodDatabaseChunk
+{
+	// Characters [begin, end) of the file; begin is the start of a line.
+	const char* begin;
+	const char* end;
+	
+	// True for the chunk that starts at the top of the file (header row).
+	bool has_header;
+	
+	// Valid rows parsed from this chunk, in file order. Descriptions point
+	// into the file text.
+	std::vector<FoodRow> rows;
+	
+	// Number of lines read from this chunk.
+	size_t line_count = 0;
+	
+	// Line within this chunk (1-based) of the first row with a bad field
+	// count, or 0 when every row was well formed.
+	size_t error_line = 0;
+	size_t error_field_count = 0;
+	std::string error_text;
+};
+
+
+// Split one data row of the food database on '^' into fields and, when it
+// has the expected three fields, parse its weight and calories.
+// Returns false when the field count is wrong. Otherwise valid reports
+// whether the row holds a usable food item.
+bool parse_food_row
+(
+	const std::string& line,
+	std::vector<std::string>& fields,
+	double& weight_ounces,
+	double& calories,
+	bool& valid
+)
+{
+	auto parse_dbl = [](const std::string& field, double& output)
+	{
+		std::stringstream ss(field);
+		if ( ! ss )
+		{
+			return false;
+		}
+		
+		ss >> output;
+		
+		return true;
+	};
+	
+	fields.clear();
+	std::stringstream ss(line);
+	
+	for (std::string field; std::getline(ss, field, '^'); )
+	{
+		fields.push_back(field);
+	}
+	
+	if (fields.size() != 3)
+	{
+		return false;
+	}
+	
+	const std::string
+		& weight_ounces_field = fields[1],
+		& calories_field = fields[2]
+		;
+	
+	valid =
+		parse_dbl(weight_ounces_field, weight_ounces)
+		&& parse_dbl(calories_field, calories)
+		;
+	
+	return true;
+}
+
+
+// Parse every line of chunk, stopping at the first row whose field count
+// is wrong. Valid rows are appended to chunk.rows.
+void parse_food_database_chunk(FoodDatabaseChunk& chunk)
+{
+	std::vector<std::string> fields;
+	std::string line;
+	
+	for (const char* pos = chunk.begin; pos < chunk.end; )
+	{
+		const char* pos_line = pos;
+		const char* newline = std::find(pos, chunk.end, '\n');
+		line.assign(pos, newline);
+		pos = (newline == chunk.end) ? newline : newline + 1;
+		
+		chunk.line_count++;
+		
+		// First line is a header row
+		if ( chunk.has_header && chunk.line_count == 1 )
+		{
+			continue;
+		}
+		
+		double weight_ounces, calories;
+		bool valid;
+		if ( ! parse_food_row(line, fields, weight_ounces, calories, valid) )
+		{
+			chunk.error_line = chunk.line_count;
+			chunk.error_field_count = fields.size();
+			chunk.error_text = line;
+			return;
+		}
+		
+		if (valid)
+		{
+			// The description is the line up to the first '^'
+			chunk.rows.push_back(FoodRow{ std::string_view(pos_line, fields[0].size()), weight_ounces, calories });
+		}
+	}
+}
+
+
+// Smallest chunk worth handing to its own thread; smaller files are parsed
+// on the calling thread.
+const size_t FOOD_DATABASE_MIN_CHUNK_BYTES = 64 * 1024;
+
+
 // Load all the valid food items from the CSV database
 // Food items that are missing fields, or have invalid values, are skipped.
 // Returns nullptr on I/O error.
+//
+// The file is split into newline-aligned chunks that are parsed on worker
+// threads and concatenated in file order, so the result (and the line
+// number reported for a malformed row) is the same as a serial read.
+// All items of the result live in a single FoodArena.
 std::unique_ptr<FoodVector> load_food_database(const std::string& path)
 {
 	std::unique_ptr<FoodVector> failure(nullptr);
 	
-	std::ifstream f(path);
+	std::ifstream f(path, std::ios::binary);
 	if (!f)
 	{
 		std::cout << "Failed to load food database; cannot open file: " << path << std::endl;
 		return failure;
 	}
 	
-	std::unique_ptr<FoodVector> result(new FoodVector);
+	std::string text;
+	{
+		std::stringstream contents;
+		contents << f.rdbuf();
+		text = contents.str();
+	}
+	f.close();
 	
-	size_t line_number = 0;
-	for (std::string line; std::getline(f, line); )
+	// Split into at most one chunk per core, each ending just after a newline
+	size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+	thread_count = std::min(thread_count, std::max<size_t>(1, text.size() / FOOD_DATABASE_MIN_CHUNK_BYTES));
+	
+	std::vector<FoodDatabaseChunk> chunks;
+	const char* const text_end = text.data() + text.size();
+	for (const char* pos = text.data(); pos < text_end; )
 	{
-		line_number++;
-		
-		// First line is a header row
-		if ( line_number == 1 )
+		const char* end = text_end;
+		size_t remaining_chunks = thread_count - chunks.size();
+		if (remaining_chunks > 1)
 		{
-			continue;
+			end = std::find(pos + (text_end - pos) / remaining_chunks, text_end, '\n');
+			if (end != text_end)
+			{
+				end++;
+			}
 		}
 		
-		std::vector<std::string> fields;
-		std::stringstream ss(line);
-		
-		for (std::string field; std::getline(ss, field, '^'); )
+		FoodDatabaseChunk chunk;
+		chunk.begin = pos;
+		chunk.end = end;
+		chunk.has_header = chunks.empty();
+		chunks.push_back(std::move(chunk));
+		pos = end;
+	}
+	
+	if (chunks.size() == 1)
+	{
+		parse_food_database_chunk(chunks[0]);
+	}
+	else
+	{
+		std::vector<std::thread> workers;
+		for (auto& chunk : chunks)
 		{
-			fields.push_back(field);
+			workers.emplace_back(parse_food_database_chunk, std::ref(chunk));
 		}
-		
-		if (fields.size() != 3)
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+	
+	std::unique_ptr<FoodVector> result(new FoodVector);
+	
+	size_t total_foods = 0;
+	for (auto& chunk : chunks)
+	{
+		total_foods += chunk.rows.size();
+	}
+	result->reserve(total_foods);
+	
+	// One arena holds every item of the database, with its control block
+	// and at most one intern table node; size it up front
+	auto arena = FoodArena::create(
+		total_foods * (sizeof(FoodItem) + 4 * sizeof(void*)) + 1
+	);
+	
+	size_t line_number = 0;
+	for (auto& chunk : chunks)
+	{
+		if (chunk.error_line != 0)
 		{
 			std::cout
-				<< "Failed to load food database: Invalid field count at line " << line_number << "; Want 3 but got " << fields.size() << std::endl
-				<< "Line: " << line << std::endl
+				<< "Failed to load food database: Invalid field count at line " << line_number + chunk.error_line << "; Want 3 but got " << chunk.error_field_count << std::endl
+				<< "Line: " << chunk.error_text << std::endl
 				;
 			return failure;
 		}
 		
-		std::string
-			descr_field = fields[0],
-			weight_ounces_field = fields[1],
-			calories_field = fields[2]
-			;
-		
-		auto parse_dbl = [](const std::string& field, double& output)
-		{
-			std::stringstream ss(field);
-			if ( ! ss )
-			{
-				return false;
-			}
-			
-			ss >> output;
-			
-			return true;
-		};
-		
-		std::string description(descr_field);
-		double weight_ounces, calories;
-		if (
-			parse_dbl(weight_ounces_field, weight_ounces)
-			&& parse_dbl(calories_field, calories)
-		)
+		for (auto& row : chunk.rows)
 		{
-			result->push_back(
-				std::shared_ptr<FoodItem>(
-					new FoodItem(
-						description,
-						weight_ounces,
-						calories
-					)
-				)
-			);
+			result->push_back(arena->make_item(row.description, row.weight_ounces, row.calories));
 		}
+		line_number += chunk.line_count;
 	}
-
-	f.close();
 	
 	return result;
 }
@@ -211,6 +769,15 @@ void print_food_vector(const FoodVector& foods)
 }
 
 
+// True when a food item with the given calories passes the calorie
+// criteria of filter_food_vector: positive, and between min_calories and
+// max_calories (inclusive).
+inline bool food_calories_match(double calories, double min_calories, double max_calories)
+{
+	return calories > 0 && calories >= min_calories && calories <= max_calories;
+}
+
+
 // Filter the vector source, i.e. create and return a new FoodVector
 // containing the subset of the food items in source that match given
 // criteria.
@@ -242,7 +809,7 @@ std::unique_ptr<FoodVector> filter_food_vector
 	std::unique_ptr<FoodVector> newFood(new FoodVector);
 
 	for ( auto & foods : source) {
-        if(foods->foodCalories() > 0 && foods->foodCalories() >= min_calories && foods->foodCalories() <= max_calories && newFood->size() < total_size) {
+        if(food_calories_match(foods->foodCalories(), min_calories, max_calories) && newFood->size() < total_size) {
             newFood->push_back(foods);
         }
     }
@@ -250,54 +817,594 @@ std::unique_ptr<FoodVector> filter_food_vector
 	return newFood;
 }
 
-// Compute the optimal set of food items with a exhaustive search algorithm.
-// Specifically, among all subsets of food items, return the subset 
-// whose weight in ounces fits within the total_weight one can carry and
-// whose total calories is greatest.
-// To avoid overflow, the size of the food items vector must be less than 64.
-std::unique_ptr<FoodVector> exhaustive_max_calories
+// As filter_food_vector, but returns a view of source instead of copying
+// the matching items. When the matches are the first items of source, the
+// result is a prefix of source and nothing is allocated; otherwise one
+// position list is.
+// Returns an empty optional when total_size is invalid.
+std::optional<FoodView> filter_food_view
 (
-	const FoodVector& foods,
-	double total_weight
+	const FoodView& source,
+	double min_calories,
+	double max_calories,
+	int total_size
 )
 {
-	double candidateWeight;
-    double candidateCalories;
-    double bestCalories;
-    double bestWeight;
+	if(total_size <= 0) {
+		std::cout << "invalid total size\n";
+		return std::nullopt;
+	}
+	
+	const size_t wanted = total_size;
+	size_t matched = 0;
+	std::shared_ptr<std::vector<uint32_t>> positions;
+	
+	for (size_t i = 0; i < source.size() && matched < wanted; i++) {
+		if(food_calories_match(source[i]->foodCalories(), min_calories, max_calories)) {
+			if (!positions && matched != i) {
+				// First gap: the matches are no longer a prefix of source
+				positions = std::make_shared<std::vector<uint32_t>>();
+				for (size_t j = 0; j < matched; j++) {
+					positions->push_back(source.position(j));
+				}
+			}
+			if (positions) {
+				positions->push_back(source.position(i));
+			}
+			matched++;
+		}
+	}
+	
+	if (!positions) {
+		return source.prefix(matched);
+	}
+	return FoodView(source.source(), positions, matched);
+}
+
+
+// Index over a FoodVector, sorted by calories, that answers the same
+// queries as filter_food_vector without scanning the whole source.
+// The source must outlive the index and must not be modified while it is
+// in use. Every index built gets a new generation, so that results
+// computed from one index are never mistaken for another's.
+class FoodCalorieIndex
+{
+	//
+	public:
+		
+		// Build the index in O(n log n).
+		explicit FoodCalorieIndex(const FoodVector& source)
+			:
+			_source(&source),
+			_generation(++generation_counter())
+		{
+			std::vector<std::pair<double, uint32_t>> entries;
+			entries.reserve(source.size());
+			for (size_t i = 0; i < source.size(); i++)
+			{
+				double calories = source[i]->foodCalories();
+				// Items that can never match (including NaN) are left out
+				if (calories > 0)
+				{
+					entries.emplace_back(calories, uint32_t(i));
+				}
+			}
+			std::sort(entries.begin(), entries.end());
+			
+			_calories.reserve(entries.size());
+			_positions.reserve(entries.size());
+			for (auto& entry : entries)
+			{
+				_calories.push_back(entry.first);
+				_positions.push_back(entry.second);
+			}
+		}
+		
+		// Positions in the source, in ascending order, of the first
+		// total_size items that filter_food_vector would keep.
+		std::vector<uint32_t> matching_positions
+		(
+			double min_calories,
+			double max_calories,
+			size_t total_size
+		) const
+		{
+			std::vector<uint32_t> result;
+			if (total_size == 0 || !(min_calories <= max_calories))
+			{
+				return result;
+			}
+			
+			auto lo = std::lower_bound(_calories.begin(), _calories.end(), min_calories);
+			auto hi = std::upper_bound(lo, _calories.end(), max_calories);
+			const size_t in_range = hi - lo;
+			if (in_range == 0)
+			{
+				return result;
+			}
+			
+			// A dense range is cheapest to find by scanning the source in
+			// order until enough items match (about total_size * n / in_range
+			// items); a sparse one by selecting from the sorted range.
+			const double expected_scan = double(total_size) * _source->size() / in_range;
+			if (expected_scan <= in_range)
+			{
+				for (size_t i = 0; i < _source->size() && result.size() < total_size; i++)
+				{
+					if (food_calories_match((*_source)[i]->foodCalories(), min_calories, max_calories))
+					{
+						result.push_back(i);
+					}
+				}
+				return result;
+			}
+			
+			const size_t first = lo - _calories.begin();
+			result.assign(_positions.begin() + first, _positions.begin() + first + in_range);
+			if (result.size() > total_size)
+			{
+				std::nth_element(result.begin(), result.begin() + total_size, result.end());
+				result.resize(total_size);
+			}
+			std::sort(result.begin(), result.end());
+			return result;
+		}
+		
+		// Same items as filter_food_view(source, min_calories, max_calories,
+		// total_size).
+		std::optional<FoodView> filter_view
+		(
+			double min_calories,
+			double max_calories,
+			int total_size
+		) const
+		{
+			if(total_size <= 0) {
+				std::cout << "invalid total size\n";
+				return std::nullopt;
+			}
+			
+			// When the matches lead the source, the view is a prefix and
+			// needs no positions; checking takes one pass over the prefix
+			const size_t wanted = std::min<size_t>(total_size, count_matching(min_calories, max_calories));
+			size_t leading = 0;
+			while (leading < wanted && food_calories_match((*_source)[leading]->foodCalories(), min_calories, max_calories))
+			{
+				leading++;
+			}
+			if (leading == wanted)
+			{
+				return FoodView(*_source, wanted);
+			}
+			
+			auto positions = std::make_shared<std::vector<uint32_t>>(
+				matching_positions(min_calories, max_calories, total_size)
+			);
+			const size_t matched = positions->size();
+			return FoodView(*_source, positions, matched);
+		}
+		
+		// Same result as filter_food_vector(source, min_calories,
+		// max_calories, total_size).
+		std::unique_ptr<FoodVector> filter
+		(
+			double min_calories,
+			double max_calories,
+			int total_size
+		) const
+		{
+			if(total_size <= 0) {
+				std::cout << "invalid total size\n";
+				return nullptr;
+			}
+			
+			std::unique_ptr<FoodVector> result(new FoodVector);
+			for (uint32_t position : matching_positions(min_calories, max_calories, total_size))
+			{
+				result->push_back((*_source)[position]);
+			}
+			return result;
+		}
+		
+		//
+		const FoodVector& source() const { return *_source; }
+		uint64_t generation() const { return _generation; }
+	
+	//
+	private:
+		// Number of items with calories in [min_calories, max_calories].
+		size_t count_matching(double min_calories, double max_calories) const
+		{
+			if (!(min_calories <= max_calories))
+			{
+				return 0;
+			}
+			auto lo = std::lower_bound(_calories.begin(), _calories.end(), min_calories);
+			return std::upper_bound(lo, _calories.end(), max_calories) - lo;
+		}
+		
+		static std::atomic<uint64_t>& generation_counter()
+		{
+			static std::atomic<uint64_t> generation{0};
+			return generation;
+		}
+		
+		const FoodVector* _source;
+		uint64_t _generation;
+		
+		// Calories of every item with positive calories, ascending, and the
+		// item's position in the source.
+		std::vector<double> _calories;
+		std::vector<uint32_t> _positions;
+};
+
+
+// Read the CSV database at path one row at a time, and pass each valid
+// food item that filter_food_vector would keep to visit, in file order.
+// Reading stops as soon as total_size items have been passed, so only one
+// row is held in memory and the rest of the file is never read.
+// Returns the number of items passed, or -1 on I/O error, an invalid
+// total_size, or a row with the wrong field count (reported as
+// load_food_database does).
+long stream_food_database
+(
+	const std::string& path,
+	double min_calories,
+	double max_calories,
+	int total_size,
+	const std::function<void(const std::shared_ptr<FoodItem>&)>& visit
+)
+{
+	if(total_size <= 0) {
+		std::cout << "invalid total size\n";
+		return -1;
+	}
+	
+	std::ifstream f(path);
+	if (!f)
+	{
+		std::cout << "Failed to load food database; cannot open file: " << path << std::endl;
+		return -1;
+	}
+	
+	long matched = 0;
+	size_t line_number = 0;
+	std::vector<std::string> fields;
+	for (std::string line; matched < total_size && std::getline(f, line); )
+	{
+		line_number++;
+		
+		// First line is a header row
+		if ( line_number == 1 )
+		{
+			continue;
+		}
+		
+		double weight_ounces, calories;
+		bool valid;
+		if ( ! parse_food_row(line, fields, weight_ounces, calories, valid) )
+		{
+			std::cout
+				<< "Failed to load food database: Invalid field count at line " << line_number << "; Want 3 but got " << fields.size() << std::endl
+				<< "Line: " << line << std::endl
+				;
+			return -1;
+		}
+		
+		if (valid && food_calories_match(calories, min_calories, max_calories))
+		{
+			visit(std::make_shared<FoodItem>(fields[0], weight_ounces, calories));
+			matched++;
+		}
+	}
+	
+	return matched;
+}
+
+
+// The same items as filter_food_vector(*load_food_database(path), ...),
+// but streamed with stream_food_database instead of loading all of it.
+// Deliberately, reading stops once total_size items match, so a malformed
+// row after them is never seen: where load_food_database would fail, this
+// may succeed. Returns nullptr on the same errors as stream_food_database.
+std::unique_ptr<FoodVector> load_filtered_food_database
+(
+	const std::string& path,
+	double min_calories,
+	double max_calories,
+	int total_size
+)
+{
+	std::unique_ptr<FoodVector> result(new FoodVector);
+	
+	long matched = stream_food_database(
+		path, min_calories, max_calories, total_size,
+		[&](const std::shared_ptr<FoodItem>& food) { result->push_back(food); }
+	);
+	
+	if (matched < 0)
+	{
+		return nullptr;
+	}
+	return result;
+}
+
+// How far a solve has got, as passed to a SolveControl's progress sink.
+struct SolveProgress
+{
+	// Units of work done and in total ("subsets" for exhaustive search,
+	// "cells" of the table for dynamic programming, "nodes" for branch and
+	// bound, whose total is unknown and NaN).
+	const char* unit;
+	double done;
+	double total;
+	
+	// done / total.
+	double fraction;
+	
+	double elapsed_seconds;
+	
+	// Units per second so far.
+	double throughput;
+	
+	// Seconds left at the current throughput; NaN when unknown.
+	double eta_seconds;
+};
+
+// Lets one thread stop a long solve running on another, either on demand
+// with cancel() or at a deadline. Solvers that accept a SolveControl poll
+// it through checkpoint() between blocks of work (every
+// SOLVE_CONTROL_CHECK_INTERVAL subsets in exhaustive search, every row in
+// dynamic programming) and then return the best answer they have, marked
+// as not proven optimal.
+// The same checkpoints feed an optional progress sink, called at most once
+// per interval and once more when the solve finishes, on the solving
+// thread. Without a sink or deadline a checkpoint is two relaxed loads.
+class SolveControl
+{
+	//
+	public:
+		typedef std::chrono::steady_clock Clock;
+		
+		// Ask the solve to stop as soon as it next checks.
+		void cancel() { _cancelled.store(true, std::memory_order_relaxed); }
+		bool cancelled() const { return _cancelled.load(std::memory_order_relaxed); }
+		
+		// Stop the solve once deadline has passed.
+		void set_deadline(Clock::time_point deadline)
+		{
+			_deadline_ns.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+		}
+		
+		// Stop the solve seconds from now.
+		void set_timeout(double seconds)
+		{
+			set_deadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+		}
+		
+		// True when the solve should stop: cancelled, or past the deadline.
+		bool should_stop() const
+		{
+			if (cancelled())
+			{
+				return true;
+			}
+			const Clock::rep deadline = _deadline_ns.load(std::memory_order_relaxed);
+			return deadline != NO_DEADLINE && Clock::now().time_since_epoch().count() >= deadline;
+		}
+	
+		// Send progress to sink at most every interval_seconds. Set this
+		// before the solve starts.
+		void set_progress(std::function<void(const SolveProgress&)> sink, double interval_seconds = 1)
+		{
+			_sink = std::move(sink);
+			_interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval_seconds));
+		}
+		
+		// Called by a solver between blocks of work, with done of total
+		// units completed (done == 0 marks the start of the solve). Reports
+		// progress when due, and returns should_stop().
+		bool checkpoint(double done, double total, const char* unit) const
+		{
+			if (_sink)
+			{
+				const Clock::time_point now = Clock::now();
+				if (done == 0)
+				{
+					_started = _last_report = now;
+				}
+				else if (now - _last_report >= _interval)
+				{
+					_last_report = now;
+					report(done, total, unit, now);
+				}
+			}
+			return should_stop();
+		}
+		
+		// Called by a solver that has done all total units.
+		void finished(double total, const char* unit) const
+		{
+			if (_sink)
+			{
+				report(total, total, unit, Clock::now());
+			}
+		}
+	
+	//
+	private:
+		static const Clock::rep NO_DEADLINE = std::numeric_limits<Clock::rep>::max();
+		
+		void report(double done, double total, const char* unit, Clock::time_point now) const
+		{
+			SolveProgress progress;
+			progress.unit = unit;
+			progress.done = done;
+			progress.total = total;
+			progress.fraction = done / total;
+			progress.elapsed_seconds = std::chrono::duration<double>(now - _started).count();
+			progress.throughput = progress.elapsed_seconds > 0 ? done / progress.elapsed_seconds : NAN;
+			progress.eta_seconds = progress.throughput > 0 ? (total - done) / progress.throughput : NAN;
+			_sink(progress);
+		}
+		
+		std::atomic<bool> _cancelled{false};
+		std::atomic<Clock::rep> _deadline_ns{NO_DEADLINE};
+		
+		std::function<void(const SolveProgress&)> _sink;
+		Clock::duration _interval{};
+		
+		// Only touched by the solving thread.
+		mutable Clock::time_point _started, _last_report;
+};
+
+// Subsets exhaustive search enumerates between checks of its SolveControl.
+const uint64_t SOLVE_CONTROL_CHECK_INTERVAL = 4096;
+
+// The answer of a solve that may have been stopped early.
+struct SolveResult
+{
+	std::unique_ptr<FoodVector> foods;
+	
+	// False when the solve was stopped before it could prove foods optimal.
+	bool proven_optimal = true;
+};
+
+// A quick approximation: take foods in decreasing order of calories per
+// ounce while they fit within total_weight. Used for the answer of a solve
+// that is stopped before it has a better one.
+std::unique_ptr<FoodVector> greedy_max_calories
+(
+	const FoodView& foods,
+	double total_weight
+)
+{
+	std::vector<size_t> order(foods.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	auto density = [&](size_t i)
+	{
+		const double weight = foods[i]->weight();
+		return weight > 0 ? foods[i]->foodCalories() / weight : HUGE_VAL;
+	};
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return density(a) > density(b); });
+	
+	std::unique_ptr<FoodVector> result(new FoodVector);
+	double weight = 0;
+	for (size_t i : order)
+	{
+		if (foods[i]->foodCalories() > 0 && weight + foods[i]->weight() <= total_weight)
+		{
+			weight += foods[i]->weight();
+			result->push_back(foods[i]);
+		}
+	}
+	return result;
+}
+
+// Whichever of a and b has more calories, preferring a.
+std::unique_ptr<FoodVector> more_calories
+(
+	std::unique_ptr<FoodVector> a,
+	std::unique_ptr<FoodVector> b
+)
+{
+	double a_weight, a_calories, b_weight, b_calories;
+	sum_food_vector(*a, a_weight, a_calories);
+	sum_food_vector(*b, b_weight, b_calories);
+	return b_calories > a_calories ? std::move(b) : std::move(a);
+}
 
+// Compute the optimal set of food items with a exhaustive search algorithm.
+// Specifically, among all subsets of food items, return the subset 
+// whose weight in ounces fits within the total_weight one can carry and
+// whose total calories is greatest.
+// To avoid overflow, the size of the food items vector must be less than 64.
+// Working memory comes from scratch.
+// When control is given and asks to stop, the best subset enumerated so far
+// is returned and *proven_optimal (if given) is set to false.
+std::unique_ptr<FoodVector> exhaustive_max_calories
+(
+	const FoodView& foods,
+	double total_weight,
+	SolverScratch& scratch,
+	const SolveControl* control = nullptr,
+	bool* proven_optimal = nullptr
+)
+{
 	const int n = foods.size();
 	assert(n < 64);
- 	
-    
-    // 2^(size of foods)
-    int nSquared = pow(2, n);
-    
-    // Optimal vector for foods
-    std::unique_ptr<FoodVector> best (new FoodVector);
-   
-    for (int i = 0; i < nSquared; i++) {
-        // Possible vector to compare with
-        std::unique_ptr<FoodVector> candidate (new FoodVector);
-        for (int j = 0; j < foods.size(); j++) {
-            if (((i >> j) & 1) == 1)
-                // Adds possible foods to candidate
-                candidate->push_back(foods[j]);
-        }
-        
-        // Returns the total weight and calories
-        sum_food_vector(*candidate, candidateWeight, candidateCalories);
-        sum_food_vector(*best, bestWeight, bestCalories);
-        
-        // If weight isn't exceeded and optimal calories
-        // give candidate foods to best
-        if (candidateWeight <= total_weight)
-            if (best->empty() || candidateCalories > bestCalories)
-                *best = *candidate;
-    }
-    
-    return best;
+	
+	SolverScratch::Session session(scratch);
+	std::pmr::memory_resource* memory = session.memory();
+	
+	// Copy the item columns out once instead of chasing pointers per subset
+	std::pmr::vector<double> weights(n, memory), calories(n, memory);
+	for (int j = 0; j < n; j++) {
+		weights[j] = foods[j]->weight();
+		calories[j] = foods[j]->foodCalories();
+	}
+	
+	// 2^(size of foods)
+	const uint64_t subsets = uint64_t(1) << n;
+	
+	// Optimal subset so far, as a bit mask over foods
+	uint64_t best_mask = 0;
+	double best_calories = 0;
+	
+	bool finished = true;
+	for (uint64_t block = 0; block < subsets; block += SOLVE_CONTROL_CHECK_INTERVAL) {
+		if (control && control->checkpoint(double(block), double(subsets), "subsets")) {
+			finished = false;
+			break;
+		}
+		
+		const uint64_t block_end = std::min(subsets, block + SOLVE_CONTROL_CHECK_INTERVAL);
+		for (uint64_t i = block; i < block_end; i++) {
+			// Total weight and calories of the candidate subset, summed in the
+			// same order as sum_food_vector would
+			double candidate_weight = 0, candidate_calories = 0;
+			for (int j = 0; j < n; j++) {
+				if (((i >> j) & 1) == 1) {
+					candidate_weight += weights[j];
+					candidate_calories += calories[j];
+				}
+			}
+			
+			// If weight isn't exceeded and optimal calories
+			// the candidate becomes the best
+			if (candidate_weight <= total_weight)
+				if (best_mask == 0 || candidate_calories > best_calories) {
+					best_mask = i;
+					best_calories = candidate_calories;
+				}
+		}
+	}
+	if (proven_optimal)
+		*proven_optimal = finished;
+	if (control && finished)
+		control->finished(double(subsets), "subsets");
+	
+	// Optimal vector for foods
+	std::unique_ptr<FoodVector> best (new FoodVector);
+	for (int j = 0; j < n; j++) {
+		if (((best_mask >> j) & 1) == 1)
+			best->push_back(foods[j]);
+	}
+	
+	return best;
+}
 
+// As above, using the calling thread's scratch memory.
+std::unique_ptr<FoodVector> exhaustive_max_calories
+(
+	const FoodView& foods,
+	double total_weight
+)
+{
+	return exhaustive_max_calories(foods, total_weight, default_solver_scratch());
 }
 
 // Compute the optimal set of food items with dynamic programming.
@@ -305,51 +1412,1062 @@ std::unique_ptr<FoodVector> exhaustive_max_calories
 // choose the foods whose calories-per-weight is greatest.
 // Repeat until no more food items can be chosen, either because we've 
 // run out of food items, or run out of space.
+// Working memory, including the (n + 1) x (W + 1) table, comes from scratch.
+// When control is given and asks to stop before the table is complete, the
+// greedy_max_calories approximation is returned and *proven_optimal (if
+// given) is set to false.
 std::unique_ptr<FoodVector> dynamic_max_calories
 (
-	const FoodVector& foods,
-	int total_weight
+	const FoodView& foods,
+	int total_weight,
+	SolverScratch& scratch,
+	const SolveControl* control = nullptr,
+	bool* proven_optimal = nullptr
 )
-
 {
 	int n = foods.size();
 	int W = total_weight;
-
-    std::vector<std::vector<double>> K(n + 1, std::vector<double>(W + 1));
+	const size_t row = size_t(W) + 1;
+	
+	SolverScratch::Session session(scratch);
+	std::pmr::memory_resource* memory = session.memory();
+	
+	// K[i][w] is stored at K[i * row + w]
+	std::pmr::vector<double> K(size_t(n + 1) * row, memory);
 	std::unique_ptr<FoodVector> best(new FoodVector);
-      
-    // Build table K[][] in bottom up manner
-    for(int i = 0; i <= n; i++)
-    {
-        for(int w = 0; w <= W; w++)
-        {
-            if (i == 0 || w == 0)
-                K[i][w] = 0;
-            else if (foods[i - 1]->weight() <= w) {
-                K[i][w] = std::max(foods[i - 1]->foodCalories() + K[i - 1][w - foods[i - 1]->weight()], K[i - 1][w]);
-		    }
-            else {
-                K[i][w] = K[i - 1][w];
+	
+	if (proven_optimal)
+		*proven_optimal = true;
+	
+	// Build table K[][] in bottom up manner
+	for(int i = 0; i <= n; i++)
+	{
+		if (control && control->checkpoint(double(i) * row, double(n + 1) * row, "cells")) {
+			if (proven_optimal)
+				*proven_optimal = false;
+			return greedy_max_calories(foods, total_weight);
+		}
+		
+		double* current = &K[i * row];
+		const double* previous = current - row;
+		const double weight = i ? foods[i - 1]->weight() : 0;
+		const double calories = i ? foods[i - 1]->foodCalories() : 0;
+		
+		for(int w = 0; w <= W; w++)
+		{
+			if (i == 0 || w == 0)
+				current[w] = 0;
+			else if (weight <= w) {
+				current[w] = std::max(calories + previous[size_t(w - weight)], previous[w]);
 			}
-        }
-    }
-
-    int w = total_weight;
-
-    for (int i = n; i > 0; i--) {
-        // Either the result comes from the top, K[i-1][w], or from (val[i-1] + K[i-1] [w-wt[i-1]])
-        // as in the Knapsack table. If it comes from the latter, the item is included.
-        if (K[i][w] == K[i - 1][w])
-            continue;   
-        else {
-            best->push_back(foods[i - 1]);
-
-            // Since this weight is included, its value is deducted.
-            w -= foods[i - 1]->weight();
-        }
-    }
+			else {
+				current[w] = previous[w];
+			}
+		}
+	}
+	
+	if (control)
+		control->finished(double(n + 1) * row, "cells");
+	
+	int w = total_weight;
+	
+	for (int i = n; i > 0; i--) {
+		// Either the result comes from the top, K[i-1][w], or from (val[i-1] + K[i-1] [w-wt[i-1]])
+		// as in the Knapsack table. If it comes from the latter, the item is included.
+		if (K[i * row + w] == K[(i - 1) * row + w])
+			continue;
+		else {
+			best->push_back(foods[i - 1]);
+			
+			// Since this weight is included, its value is deducted.
+			w -= foods[i - 1]->weight();
+		}
+	}
+	
+	return best;
+}
 
-  return best;
+// As above, using the calling thread's scratch memory.
+std::unique_ptr<FoodVector> dynamic_max_calories
+(
+	const FoodView& foods,
+	int total_weight
+)
+{
+	return dynamic_max_calories(foods, total_weight, default_solver_scratch());
 }
 
-//
+// exhaustive_max_calories under control. A stopped search returns the
+// better of its best subset so far and the greedy approximation.
+SolveResult exhaustive_max_calories
+(
+	const FoodView& foods,
+	double total_weight,
+	const SolveControl& control
+)
+{
+	SolveResult result;
+	result.foods = exhaustive_max_calories(foods, total_weight, default_solver_scratch(), &control, &result.proven_optimal);
+	if (!result.proven_optimal)
+	{
+		result.foods = more_calories(std::move(result.foods), greedy_max_calories(foods, total_weight));
+	}
+	return result;
+}
+
+// dynamic_max_calories under control.
+SolveResult dynamic_max_calories
+(
+	const FoodView& foods,
+	int total_weight,
+	const SolveControl& control
+)
+{
+	SolveResult result;
+	result.foods = dynamic_max_calories(foods, total_weight, default_solver_scratch(), &control, &result.proven_optimal);
+	return result;
+}
+
+// A solution found by branch_and_bound_max_calories while it searches.
+struct Incumbent
+{
+	double calories;
+	double weight;
+	
+	// Positions in foods of the chosen items, ascending.
+	std::vector<size_t> indices;
+	
+	// Seconds since the search started.
+	double elapsed_seconds;
+};
+
+// Anytime branch and bound search for the optimal set of foods. Foods are
+// tried in decreasing order of calories per ounce, depth first, taking an
+// item before leaving it out, and a branch is pruned when even its
+// fractional relaxation cannot beat the incumbent. The search starts from
+// the greedy solution, and every improving solution is passed to
+// on_incumbent (when given) as soon as it is found, so a caller can show a
+// good answer long before optimality is proven.
+// When control is given and asks to stop (checked every
+// SOLVE_CONTROL_CHECK_INTERVAL nodes), the incumbent is returned and
+// *proven_optimal (if given) is set to false.
+class BranchAndBoundSearch
+{
+	//
+	public:
+		BranchAndBoundSearch
+		(
+			const FoodView& foods,
+			double total_weight,
+			const std::function<void(const Incumbent&)>& on_incumbent,
+			const SolveControl* control
+		)
+		:
+			_foods(foods),
+			_total_weight(total_weight),
+			_on_incumbent(on_incumbent),
+			_control(control),
+			_start(std::chrono::steady_clock::now())
+		{
+			// Only items that can be part of an improving solution
+			for (size_t i = 0; i < foods.size(); i++)
+			{
+				if (foods[i]->foodCalories() > 0 && foods[i]->weight() >= 0 && foods[i]->weight() <= total_weight)
+				{
+					_order.push_back(i);
+				}
+			}
+			auto density = [&](size_t i)
+			{
+				const double weight = foods[i]->weight();
+				return weight > 0 ? foods[i]->foodCalories() / weight : HUGE_VAL;
+			};
+			std::stable_sort(_order.begin(), _order.end(), [&](size_t a, size_t b) { return density(a) > density(b); });
+			
+			for (size_t i : _order)
+			{
+				_weights.push_back(foods[i]->weight());
+				_calories.push_back(foods[i]->foodCalories());
+			}
+			_take.assign(_order.size(), false);
+			_best_take = _take;
+		}
+		
+		// Search to the end, or until control stops it. Returns true when
+		// the search finished, proving the result optimal.
+		bool run()
+		{
+			if (!(_total_weight >= 0))
+			{
+				return true;
+			}
+			
+			// Greedy start: the first leaf of the depth-first search
+			double weight = 0, calories = 0;
+			for (size_t i = 0; i < _order.size(); i++)
+			{
+				if (weight + _weights[i] <= _total_weight)
+				{
+					_take[i] = true;
+					weight += _weights[i];
+					calories += _calories[i];
+				}
+			}
+			improve(weight, calories);
+			std::fill(_take.begin(), _take.end(), false);
+			
+			search();
+			if (_control && !_stopped)
+			{
+				_control->finished(double(_nodes), "nodes");
+			}
+			return !_stopped;
+		}
+		
+		// The best solution found, in foods order.
+		std::unique_ptr<FoodVector> best() const
+		{
+			std::unique_ptr<FoodVector> result(new FoodVector);
+			for (size_t i : best_indices())
+			{
+				result->push_back(_foods[i]);
+			}
+			return result;
+		}
+	
+	//
+	private:
+		// Depth-first search with an explicit stack, as the path can be as
+		// deep as there are candidate items.
+		void search()
+		{
+			// A node at depth i has decided items 0 to i - 1; taken is the
+			// decision on item i - 1.
+			struct Node
+			{
+				size_t i;
+				double weight, calories;
+				bool taken;
+			};
+			std::vector<Node> stack = { Node{ 0, 0, 0, false } };
+			
+			// Items from depth on are not taken on the current path
+			size_t depth = 0;
+			while (!stack.empty())
+			{
+				const Node node = stack.back();
+				stack.pop_back();
+				if (_control && _nodes++ % SOLVE_CONTROL_CHECK_INTERVAL == 0 && _control->checkpoint(double(_nodes - 1), NAN, "nodes"))
+				{
+					_stopped = true;
+					return;
+				}
+				
+				for (size_t j = node.i; j < depth; j++)
+				{
+					_take[j] = false;
+				}
+				if (node.i > 0)
+				{
+					_take[node.i - 1] = node.taken;
+				}
+				depth = node.i;
+				
+				if (node.calories > _best_calories)
+				{
+					improve(node.weight, node.calories);
+				}
+				if (node.i == _order.size() || bound(node.i, node.weight, node.calories) <= _best_calories * (1 + 1e-12))
+				{
+					continue;
+				}
+				
+				// Pushed last, so the branch taking item i is searched first
+				stack.push_back(Node{ node.i + 1, node.weight, node.calories, false });
+				if (node.weight + _weights[node.i] <= _total_weight)
+				{
+					stack.push_back(Node{ node.i + 1, node.weight + _weights[node.i], node.calories + _calories[node.i], true });
+				}
+			}
+		}
+		
+		// Upper bound on the calories of any completion of the current
+		// branch from item i on: fill greedily, then a fraction of the
+		// first item that does not fit.
+		double bound(size_t i, double weight, double calories) const
+		{
+			double room = _total_weight - weight;
+			for (; i < _order.size(); i++)
+			{
+				if (_weights[i] <= room)
+				{
+					room -= _weights[i];
+					calories += _calories[i];
+				}
+				else
+				{
+					return calories + _calories[i] * room / _weights[i];
+				}
+			}
+			return calories;
+		}
+		
+		void improve(double weight, double calories)
+		{
+			_best_take = _take;
+			_best_calories = calories;
+			if (_on_incumbent)
+			{
+				Incumbent incumbent;
+				incumbent.calories = calories;
+				incumbent.weight = weight;
+				incumbent.indices = best_indices();
+				incumbent.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+				_on_incumbent(incumbent);
+			}
+		}
+		
+		std::vector<size_t> best_indices() const
+		{
+			std::vector<size_t> indices;
+			for (size_t i = 0; i < _order.size(); i++)
+			{
+				if (_best_take[i])
+				{
+					indices.push_back(_order[i]);
+				}
+			}
+			std::sort(indices.begin(), indices.end());
+			return indices;
+		}
+		
+		const FoodView& _foods;
+		const double _total_weight;
+		const std::function<void(const Incumbent&)>& _on_incumbent;
+		const SolveControl* _control;
+		const std::chrono::steady_clock::time_point _start;
+		
+		// Candidate items by decreasing density: position in foods, weight
+		// and calories.
+		std::vector<size_t> _order;
+		std::vector<double> _weights, _calories;
+		
+		// Items taken on the current branch, and in the incumbent.
+		std::vector<bool> _take, _best_take;
+		double _best_calories = 0;
+		
+		uint64_t _nodes = 0;
+		bool _stopped = false;
+};
+
+// Run a BranchAndBoundSearch; see there.
+std::unique_ptr<FoodVector> branch_and_bound_max_calories
+(
+	const FoodView& foods,
+	double total_weight,
+	const std::function<void(const Incumbent&)>& on_incumbent = nullptr,
+	const SolveControl* control = nullptr,
+	bool* proven_optimal = nullptr
+)
+{
+	BranchAndBoundSearch search(foods, total_weight, on_incumbent, control);
+	bool finished = search.run();
+	if (proven_optimal)
+	{
+		*proven_optimal = finished;
+	}
+	return search.best();
+}
+
+// branch_and_bound_max_calories under control.
+SolveResult branch_and_bound_max_calories
+(
+	const FoodView& foods,
+	double total_weight,
+	const SolveControl& control
+)
+{
+	SolveResult result;
+	result.foods = branch_and_bound_max_calories(foods, total_weight, nullptr, &control, &result.proven_optimal);
+	return result;
+}
+
+// What dynamic_max_calories computes for foods and a capacity W, kept in
+// a form that answers every capacity w <= W: the last row of the table
+// (the optimal calories for each w), and one keep bit per item and
+// capacity recording K[i][w] != K[i-1][w]. Reconstructing from the bits
+// gives exactly the foods dynamic_max_calories(foods, w) returns, in
+// 1/64 of the memory of the full table.
+class DynamicKnapsackTable
+{
+	//
+	public:
+		DynamicKnapsackTable(const FoodView& foods, int total_weight)
+		:
+			_foods(foods.to_food_vector()),
+			_capacity(total_weight),
+			_row(size_t(total_weight) + 1),
+			_words_per_item((size_t(total_weight) + 64) / 64),
+			_keep(_foods->size() * _words_per_item)
+		{
+			assert(total_weight >= 0);
+			
+			// One row, updated from high w to low so previous-row values are
+			// read before they are overwritten
+			for (size_t i = 0; i < _foods->size(); i++)
+			{
+				const double weight = (*_foods)[i]->weight();
+				const double calories = (*_foods)[i]->foodCalories();
+				uint64_t* keep = &_keep[i * _words_per_item];
+				for (int w = _capacity; w > 0; w--)
+				{
+					if (weight <= w)
+					{
+						const double take = calories + _row[size_t(w - weight)];
+						const double best = std::max(take, _row[w]);
+						if (best != _row[w])
+						{
+							keep[w / 64] |= uint64_t(1) << (w % 64);
+							_row[w] = best;
+						}
+					}
+				}
+			}
+		}
+		
+		// Largest capacity the table answers.
+		int capacity() const { return _capacity; }
+		
+		// The foods the table was built for.
+		const FoodVector& foods() const { return *_foods; }
+		
+		// True when the table was built for the same items as foods, in
+		// the same order.
+		bool same_foods(const FoodView& foods) const
+		{
+			if (foods.size() != _foods->size())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < foods.size(); i++)
+			{
+				if (foods[i] != (*_foods)[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		
+		// Optimal calories within capacity w <= capacity().
+		double best_calories(int w) const
+		{
+			assert(w >= 0 && w <= _capacity);
+			return _row[w];
+		}
+		
+		// The foods dynamic_max_calories(foods(), w) returns, for w <= capacity().
+		std::unique_ptr<FoodVector> solve(int total_weight) const
+		{
+			assert(total_weight >= 0 && total_weight <= _capacity);
+			std::unique_ptr<FoodVector> best(new FoodVector);
+			int w = total_weight;
+			for (size_t i = _foods->size(); i > 0; i--)
+			{
+				if ((_keep[(i - 1) * _words_per_item + w / 64] >> (w % 64)) & 1)
+				{
+					best->push_back((*_foods)[i - 1]);
+					w -= (*_foods)[i - 1]->weight();
+				}
+			}
+			return best;
+		}
+		
+		// Memory held by the table.
+		size_t size_in_bytes() const
+		{
+			return sizeof(*this)
+				+ _foods->capacity() * sizeof(FoodVector::value_type)
+				+ _row.capacity() * sizeof(double)
+				+ _keep.capacity() * sizeof(uint64_t)
+				;
+		}
+	
+	//
+	private:
+		std::unique_ptr<FoodVector> _foods;
+		int _capacity;
+		std::vector<double> _row;
+		size_t _words_per_item;
+		std::vector<uint64_t> _keep;
+};
+
+
+// The most recently used DynamicKnapsackTables, so that a query for the
+// same foods at a smaller capacity skips the dynamic program entirely.
+// Holds at most max_tables tables and max_bytes of memory. It is safe to
+// share between threads.
+class DynamicTableCache
+{
+	//
+	public:
+		explicit DynamicTableCache(size_t max_tables = 4, size_t max_bytes = 64 * 1024 * 1024)
+		:
+			_max_tables(max_tables),
+			_max_bytes(max_bytes)
+		{ }
+		
+		// A table for foods covering total_weight: a cached one when
+		// possible, otherwise a new one, which is then cached.
+		std::shared_ptr<const DynamicKnapsackTable> table(const FoodView& foods, int total_weight)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (auto it = _tables.begin(); it != _tables.end(); ++it)
+				{
+					if ((*it)->capacity() >= total_weight && (*it)->same_foods(foods))
+					{
+						_hits++;
+						_tables.splice(_tables.begin(), _tables, it);
+						return _tables.front();
+					}
+				}
+				_misses++;
+			}
+			
+			auto built = std::make_shared<const DynamicKnapsackTable>(foods, total_weight);
+			
+			std::lock_guard<std::mutex> lock(_mutex);
+			const size_t bytes = built->size_in_bytes();
+			if (bytes > _max_bytes || _max_tables == 0)
+			{
+				return built;
+			}
+			
+			// A smaller table for the same foods is now useless
+			for (auto it = _tables.begin(); it != _tables.end(); )
+			{
+				if ((*it)->capacity() <= total_weight && (*it)->same_foods(foods))
+				{
+					_bytes -= (*it)->size_in_bytes();
+					it = _tables.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			while (!_tables.empty() && (_tables.size() >= _max_tables || _bytes + bytes > _max_bytes))
+			{
+				_bytes -= _tables.back()->size_in_bytes();
+				_tables.pop_back();
+			}
+			_tables.push_front(built);
+			_bytes += bytes;
+			return built;
+		}
+		
+		// Drop every table.
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_tables.clear();
+			_bytes = 0;
+		}
+		
+		uint64_t hits() const { std::lock_guard<std::mutex> lock(_mutex); return _hits; }
+		uint64_t misses() const { std::lock_guard<std::mutex> lock(_mutex); return _misses; }
+		size_t size() const { std::lock_guard<std::mutex> lock(_mutex); return _tables.size(); }
+		size_t bytes() const { std::lock_guard<std::mutex> lock(_mutex); return _bytes; }
+	
+	//
+	private:
+		const size_t _max_tables, _max_bytes;
+		
+		mutable std::mutex _mutex;
+		// Most recently used first
+		std::list<std::shared_ptr<const DynamicKnapsackTable>> _tables;
+		size_t _bytes = 0;
+		uint64_t _hits = 0, _misses = 0;
+};
+
+// The process-wide table cache behind the registered "dynamic" solver.
+DynamicTableCache& default_dynamic_table_cache()
+{
+	static DynamicTableCache cache;
+	return cache;
+}
+
+// Same result as dynamic_max_calories(foods, total_weight), answered from
+// a cached table for the same foods and an equal or larger capacity when
+// there is one.
+std::unique_ptr<FoodVector> dynamic_max_calories_reusing
+(
+	const FoodView& foods,
+	int total_weight,
+	DynamicTableCache& cache
+)
+{
+	return cache.table(foods, total_weight)->solve(total_weight);
+}
+
+// As above, using the process-wide cache.
+std::unique_ptr<FoodVector> dynamic_max_calories_reusing
+(
+	const FoodView& foods,
+	int total_weight
+)
+{
+	return dynamic_max_calories_reusing(foods, total_weight, default_dynamic_table_cache());
+}
+
+// True when weight is a whole number from 0 to INT_MAX.
+bool whole_weight(double weight)
+{
+	return weight >= 0 && weight <= std::numeric_limits<int>::max() && weight == std::floor(weight);
+}
+
+// True when total_weight and the weight of every food are whole, as the
+// dynamic programming solvers need.
+bool whole_food_weights(const FoodView& foods, double total_weight)
+{
+	if (!whole_weight(total_weight))
+	{
+		return false;
+	}
+	for (size_t i = 0; i < foods.size(); i++)
+	{
+		if (!whole_weight(foods[i]->weight()))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// A solver registered by name, so that tools can run every algorithm
+// without knowing them in advance.
+struct FoodSolver
+{
+	std::string name;
+	
+	// Largest number of foods the solver can be asked to handle.
+	size_t max_size;
+	
+	// True when the solver only takes whole weights from 0 to INT_MAX, for
+	// total_weight and for every food; it gives no answer for anything
+	// else. Check with food_solver_accepts_weight and
+	// food_solver_accepts_foods before solving.
+	bool integer_weights;
+	
+	std::function<std::unique_ptr<FoodVector>(const FoodView&, double)> solve;
+	
+	// Solve under a SolveControl; may be empty, in which case the control
+	// is only checked before the solve starts.
+	std::function<SolveResult(const FoodView&, double, const SolveControl&)> solve_with_control;
+	
+	// Solve for several capacities at once, sharing work between them; may
+	// be empty. Element i of the result answers total_weights[i].
+	std::function<std::vector<std::unique_ptr<FoodVector>>(const FoodView&, const std::vector<double>&)> solve_capacities;
+};
+
+// Every registered solver; exhaustive_max_calories comes first and is the
+// reference the others are checked against.
+std::vector<FoodSolver>& food_solver_registry()
+{
+	static std::vector<FoodSolver> solvers = {
+		{
+			"exhaustive", 30, false,
+			[](const FoodView& foods, double total_weight) { return exhaustive_max_calories(foods, total_weight); },
+			[](const FoodView& foods, double total_weight, const SolveControl& control) { return exhaustive_max_calories(foods, total_weight, control); }
+		},
+		{
+			"dynamic", SIZE_MAX, true,
+			[](const FoodView& foods, double total_weight)
+			{
+				if (!whole_food_weights(foods, total_weight))
+				{
+					return std::unique_ptr<FoodVector>();
+				}
+				return dynamic_max_calories_reusing(foods, int(total_weight));
+			},
+			[](const FoodView& foods, double total_weight, const SolveControl& control)
+			{
+				if (!whole_food_weights(foods, total_weight))
+				{
+					return SolveResult();
+				}
+				return dynamic_max_calories(foods, int(total_weight), control);
+			},
+			[](const FoodView& foods, const std::vector<double>& total_weights)
+			{
+				// One table, built for the largest capacity, answers them all
+				std::vector<std::unique_ptr<FoodVector>> answers(total_weights.size());
+				double largest = 0;
+				for (double total_weight : total_weights)
+				{
+					if (whole_weight(total_weight))
+					{
+						largest = std::max(largest, total_weight);
+					}
+				}
+				if (!whole_food_weights(foods, largest))
+				{
+					return answers;
+				}
+				DynamicKnapsackTable table(foods, int(largest));
+				for (size_t i = 0; i < total_weights.size(); i++)
+				{
+					if (whole_weight(total_weights[i]))
+					{
+						answers[i] = table.solve(int(total_weights[i]));
+					}
+				}
+				return answers;
+			}
+		},
+		{
+			"branch_and_bound", SIZE_MAX, false,
+			[](const FoodView& foods, double total_weight) { return branch_and_bound_max_calories(foods, total_weight); },
+			[](const FoodView& foods, double total_weight, const SolveControl& control) { return branch_and_bound_max_calories(foods, total_weight, control); }
+		},
+	};
+	return solvers;
+}
+
+// Add a solver to the registry, replacing any solver with the same name.
+void register_food_solver(const FoodSolver& solver)
+{
+	auto& solvers = food_solver_registry();
+	for (auto& existing : solvers)
+	{
+		if (existing.name == solver.name)
+		{
+			existing = solver;
+			return;
+		}
+	}
+	solvers.push_back(solver);
+}
+
+// The solver registered under name, or nullptr.
+const FoodSolver* find_food_solver(const std::string& name)
+{
+	for (auto& solver : food_solver_registry())
+	{
+		if (solver.name == name)
+		{
+			return &solver;
+		}
+	}
+	return nullptr;
+}
+
+// True when solver can be asked for total_weight. Otherwise returns false
+// and describes the problem in error.
+bool food_solver_accepts_weight(const FoodSolver& solver, double total_weight, std::string& error)
+{
+	if (!(total_weight >= 0) || !std::isfinite(total_weight))
+	{
+		error = "total weight must be finite and non-negative";
+		return false;
+	}
+	if (solver.integer_weights && !whole_weight(total_weight))
+	{
+		std::ostringstream ss;
+		ss << solver.name << " needs a whole total weight of at most " << std::numeric_limits<int>::max();
+		error = ss.str();
+		return false;
+	}
+	return true;
+}
+
+// True when solver can be asked about foods. Otherwise returns false and
+// describes the problem in error.
+bool food_solver_accepts_foods(const FoodSolver& solver, const FoodView& foods, std::string& error)
+{
+	if (solver.integer_weights && !whole_food_weights(foods, 0))
+	{
+		std::ostringstream ss;
+		ss << solver.name << " needs every food to weigh a whole number of at most " << std::numeric_limits<int>::max();
+		error = ss.str();
+		return false;
+	}
+	return true;
+}
+
+// Solve with solver under control: through solve_with_control when the
+// solver has it, and otherwise by checking control once before solving.
+SolveResult run_food_solver
+(
+	const FoodSolver& solver,
+	const FoodView& foods,
+	double total_weight,
+	const SolveControl& control
+)
+{
+	if (solver.solve_with_control)
+	{
+		return solver.solve_with_control(foods, total_weight, control);
+	}
+	SolveResult result;
+	if (control.should_stop())
+	{
+		result.foods = greedy_max_calories(foods, total_weight);
+		result.proven_optimal = false;
+	}
+	else
+	{
+		result.foods = solver.solve(foods, total_weight);
+	}
+	return result;
+}
+
+// A solve running on its own thread. Destroying the handle waits for the
+// solve to finish, so cancel() first to abandon one.
+class SolveHandle
+{
+	//
+	public:
+		SolveHandle(std::shared_ptr<SolveControl> control, std::future<SolveResult> result)
+		:
+			_control(std::move(control)),
+			_result(std::move(result))
+		{ }
+		
+		// Ask the solve to stop and return the best answer it has.
+		void cancel() { _control->cancel(); }
+		
+		SolveControl& control() { return *_control; }
+		
+		// Wait up to seconds for the result; true when it is ready.
+		bool wait_for(double seconds) const
+		{
+			return _result.wait_for(std::chrono::duration<double>(seconds)) == std::future_status::ready;
+		}
+		
+		// Wait for and take the result; call at most once.
+		SolveResult get() { return _result.get(); }
+	
+	//
+	private:
+		std::shared_ptr<SolveControl> _control;
+		std::future<SolveResult> _result;
+};
+
+// Start the registered solver named algorithm on a new thread. With a
+// positive timeout_seconds the solve stops at that deadline. When progress
+// is given, it is called on the solving thread every progress_interval
+// seconds (see SolveControl). The solve works on its own copy of foods
+// (sharing the items), so foods and its source need not outlive it. An
+// unknown algorithm, more foods than the solver handles, or a total_weight
+// or foods it does not accept gives a result without foods.
+SolveHandle solve_async
+(
+	const std::string& algorithm,
+	const FoodView& foods,
+	double total_weight,
+	double timeout_seconds = 0,
+	std::function<void(const SolveProgress&)> progress = nullptr,
+	double progress_interval = 1
+)
+{
+	auto control = std::make_shared<SolveControl>();
+	if (timeout_seconds > 0)
+	{
+		control->set_timeout(timeout_seconds);
+	}
+	if (progress)
+	{
+		control->set_progress(std::move(progress), progress_interval);
+	}
+	
+	const FoodSolver* solver = find_food_solver(algorithm);
+	std::string error;
+	if (!solver || foods.size() > solver->max_size || !food_solver_accepts_weight(*solver, total_weight, error)
+		|| !food_solver_accepts_foods(*solver, foods, error))
+	{
+		std::cout << "Cannot solve " << foods.size() << " foods with algorithm: " << algorithm;
+		if (!error.empty())
+		{
+			std::cout << " (" << error << ")";
+		}
+		std::cout << std::endl;
+		std::promise<SolveResult> failed;
+		failed.set_value(SolveResult());
+		return SolveHandle(control, failed.get_future());
+	}
+	
+	// Copy the solver, so that the registry may change meanwhile, and the
+	// foods, as a view may be of a temporary
+	std::shared_ptr<const FoodVector> owned = foods.to_food_vector();
+	auto result = std::async(std::launch::async, [solver = *solver, owned, total_weight, control]()
+	{
+		return run_food_solver(solver, FoodView(*owned), total_weight, *control);
+	});
+	return SolveHandle(control, std::move(result));
+}
+
+// One step of a prefix sweep: the optimum for the first n items.
+struct SweepPoint
+{
+	// Prefix length, from 1 to foods.size().
+	size_t n;
+	
+	// Optimal total calories for the first n items.
+	double calories;
+	
+	// Seconds spent extending the solution from n - 1 to n items, and
+	// since the sweep started.
+	double step_seconds;
+	double elapsed_seconds;
+};
+
+
+// Solve dynamic_max_calories for every prefix of foods in a single
+// O(n * W) pass: one table row is extended by one item per step, and
+// visit is called with the optimum after each item. The optima are the
+// values dynamic_max_calories' table reaches for the same prefixes.
+// visit may run other solves, even with the same scratch; they get memory
+// of their own (see SolverScratch::Session).
+void dynamic_max_calories_sweep
+(
+	const FoodView& foods,
+	int total_weight,
+	const std::function<void(const SweepPoint&)>& visit,
+	SolverScratch& scratch
+)
+{
+	typedef std::chrono::steady_clock clock;
+	const int n = foods.size();
+	const int W = total_weight;
+	
+	SolverScratch::Session session(scratch);
+	std::pmr::memory_resource* memory = session.memory();
+	
+	// K[w] holds row i of dynamic_max_calories' table after step i. Going
+	// from high to low w, K[w - weight] still holds row i - 1.
+	std::pmr::vector<double> K(size_t(W) + 1, 0.0, memory);
+	
+	const auto start = clock::now();
+	auto step_start = start;
+	for (int i = 1; i <= n; i++)
+	{
+		const double weight = foods[i - 1]->weight();
+		const double calories = foods[i - 1]->foodCalories();
+		
+		for (int w = W; w > 0; w--)
+		{
+			if (weight <= w)
+			{
+				K[w] = std::max(calories + K[size_t(w - weight)], K[w]);
+			}
+		}
+		
+		const auto now = clock::now();
+		visit(SweepPoint{
+			size_t(i),
+			K[W],
+			std::chrono::duration<double>(now - step_start).count(),
+			std::chrono::duration<double>(now - start).count()
+		});
+		step_start = now;
+	}
+}
+
+// As above, using the calling thread's scratch memory.
+void dynamic_max_calories_sweep
+(
+	const FoodView& foods,
+	int total_weight,
+	const std::function<void(const SweepPoint&)>& visit
+)
+{
+	dynamic_max_calories_sweep(foods, total_weight, visit, default_solver_scratch());
+}
+
+// Solve exhaustive_max_calories for every prefix of foods with one
+// enumeration: the subsets of the first n items are the subsets of the
+// first n - 1 items, plus each of them with item n added, so every step
+// only sums the 2^(n-1) new subsets, and the whole sweep costs O(2^n)
+// instead of O(2^n * n^2). visit is called with the optimum after each
+// item; it equals the calories of exhaustive_max_calories' answer, because
+// subset totals are summed in the same item order.
+// The subset totals take 16 * 2^n bytes of scratch memory, so foods may
+// have at most EXHAUSTIVE_SWEEP_MAX_SIZE items (256MB); with more, the
+// problem is reported and visit is never called. As with
+// dynamic_max_calories_sweep, visit may run other solves.
+const int EXHAUSTIVE_SWEEP_MAX_SIZE = 24;
+
+void exhaustive_max_calories_sweep
+(
+	const FoodView& foods,
+	double total_weight,
+	const std::function<void(const SweepPoint&)>& visit,
+	SolverScratch& scratch
+)
+{
+	typedef std::chrono::steady_clock clock;
+	if (foods.size() > size_t(EXHAUSTIVE_SWEEP_MAX_SIZE))
+	{
+		std::cout << "Cannot sweep " << foods.size() << " foods exhaustively; at most " << EXHAUSTIVE_SWEEP_MAX_SIZE << std::endl;
+		return;
+	}
+	const int n = foods.size();
+	
+	SolverScratch::Session session(scratch);
+	std::pmr::memory_resource* memory = session.memory();
+	
+	// Totals of every subset of the items seen so far, indexed by bit mask
+	const size_t subsets = size_t(1) << n;
+	std::pmr::vector<double> subset_weight(subsets, memory), subset_calories(subsets, memory);
+	subset_weight[0] = subset_calories[0] = 0;
+	
+	// Like exhaustive_max_calories, the first feasible non-empty subset
+	// replaces the empty one even when it has fewer calories
+	bool have_best = false;
+	double best_calories = 0;
+	
+	const auto start = clock::now();
+	auto step_start = start;
+	for (int j = 0; j < n; j++)
+	{
+		const double weight = foods[j]->weight();
+		const double calories = foods[j]->foodCalories();
+		const size_t half = size_t(1) << j;
+		
+		for (size_t s = 0; s < half; s++)
+		{
+			const double candidate_weight = subset_weight[s] + weight;
+			const double candidate_calories = subset_calories[s] + calories;
+			subset_weight[half + s] = candidate_weight;
+			subset_calories[half + s] = candidate_calories;
+			
+			if (candidate_weight <= total_weight && (!have_best || candidate_calories > best_calories))
+			{
+				have_best = true;
+				best_calories = candidate_calories;
+			}
+		}
+		
+		const auto now = clock::now();
+		visit(SweepPoint{
+			size_t(j + 1),
+			best_calories,
+			std::chrono::duration<double>(now - step_start).count(),
+			std::chrono::duration<double>(now - start).count()
+		});
+		step_start = now;
+	}
+}
+
+// As above, using the calling thread's scratch memory.
+void exhaustive_max_calories_sweep
+(
+	const FoodView& foods,
+	double total_weight,
+	const std::function<void(const SweepPoint&)>& visit
+)
+{
+	exhaustive_max_calories_sweep(foods, total_weight, visit, default_solver_scratch());
+}
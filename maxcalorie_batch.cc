@@ -0,0 +1,335 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxcalorie_batch.cc
+//
+// Batch mode: answers a file of knapsack queries in one run. Queries that
+// filter the database the same way and use the same algorithm form a
+// group; each group is filtered once and, for solvers that can, such as
+// dynamic programming, solved for all its capacities at once (see
+// answer_food_query_group). Groups run on a worker pool, largest first,
+// and results are streamed to the output CSV in input order as soon as
+// every earlier query has been answered.
+//
+// Usage: maxcalorie_batch [--db PATH] [--snapshot PATH] [--threads N]
+//	[--out PATH] [--max-weight W] QUERIES
+//
+// QUERIES has one query per line in the form parsed by parse_food_query,
+//
+//	MIN_CALORIES MAX_CALORIES TOTAL_SIZE TOTAL_WEIGHT [ALGORITHM]
+//
+// and blank lines and lines starting with '#' are skipped. Queries with a
+// TOTAL_WEIGHT above --max-weight (default 1000000) fail, as do groups
+// whose solve throws, such as on running out of memory. The output
+// (default batch_results.csv) has one row per query:
+//
+//	line,min_calories,max_calories,total_size,total_weight,algorithm,
+//	count,weight,calories,items,error
+//
+// where items lists the chosen foods' row numbers in the database
+// (0-based, header excluded) separated by spaces, and error is empty for
+// answered queries.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "foodtable.hh"
+#include "maxcalorie.hh"
+#include "maxcalorie_query.hh"
+#include "timer.hh"
+#include "worker_pool.hh"
+
+using namespace std;
+
+// One line of the query file.
+struct BatchQuery
+{
+  size_t line;
+  FoodQuery query;
+  string error;
+};
+
+// Quote a CSV field when it needs it.
+string csv_field(const string& text)
+{
+  if (text.find_first_of(",\"\n") == string::npos)
+  {
+    return text;
+  }
+  string quoted = "\"";
+  for (char c : text)
+  {
+    quoted += c;
+    if (c == '"')
+    {
+      quoted += '"';
+    }
+  }
+  return quoted + "\"";
+}
+
+// Rough cost of answering a group, for scheduling the biggest first.
+// Solvers that share work across capacities are costed as one dynamic
+// programming table for the largest.
+double group_cost(const vector<FoodQuery>& queries)
+{
+  const FoodQuery& first = queries[0];
+  const FoodSolver* solver = find_food_solver(first.algorithm);
+  if (solver && solver->solve_capacities)
+  {
+    double largest = 0;
+    for (auto& query : queries)
+    {
+      largest = max(largest, query.total_weight);
+    }
+    return double(first.total_size) * (largest + 1);
+  }
+  return queries.size() * first.total_size * ldexp(1.0, min(first.total_size, 62));
+}
+
+int main(int argc, char* argv[])
+{
+  string db_path = "food.csv";
+  string snapshot_path;
+  string out_path = "batch_results.csv";
+  string queries_path;
+  unsigned threads = 0;
+  FoodQueryLimits limits;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string flag = argv[i];
+    if (flag.compare(0, 2, "--") != 0)
+    {
+      queries_path = flag;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      cout << "Missing value for " << flag << endl;
+      return 2;
+    }
+    string value = argv[++i];
+
+    if (flag == "--db") db_path = value;
+    else if (flag == "--snapshot") snapshot_path = value;
+    else if (flag == "--out") out_path = value;
+    else if (flag == "--threads") threads = atoi(value.c_str());
+    else if (flag == "--max-weight") limits.max_total_weight = atof(value.c_str());
+    else
+    {
+      cout << "Invalid option " << flag << endl;
+      return 2;
+    }
+  }
+  if (queries_path.empty())
+  {
+    cout << "Usage: maxcalorie_batch [--db PATH] [--snapshot PATH] [--threads N] [--out PATH] [--max-weight W] QUERIES" << endl;
+    return 2;
+  }
+
+  Timer timer;
+
+  // Read every query, remembering its line for the output
+  ifstream in(queries_path);
+  if (!in)
+  {
+    cout << "Cannot open " << queries_path << endl;
+    return 1;
+  }
+  vector<BatchQuery> queries;
+  string text;
+  for (size_t line = 1; getline(in, text); line++)
+  {
+    if (!text.empty() && text.back() == '\r')
+    {
+      text.pop_back();
+    }
+    if (text.find_first_not_of(" \t") == string::npos || text[text.find_first_not_of(" \t")] == '#')
+    {
+      continue;
+    }
+    BatchQuery query;
+    query.line = line;
+    parse_food_query(text, query.query, query.error, limits);
+    queries.push_back(query);
+  }
+
+  auto foods = snapshot_path.empty() ? load_food_database(db_path) : load_food_database_cached(db_path, snapshot_path);
+  if (!foods)
+  {
+    return 1;
+  }
+  const FoodCalorieIndex index(*foods);
+  unordered_map<const FoodItem*, size_t> rows;
+  for (size_t i = 0; i < foods->size(); i++)
+  {
+    rows[(*foods)[i].get()] = i;
+  }
+
+  // Group the parsed queries; members are indices into queries
+  map<tuple<double, double, int, string>, size_t> group_of;
+  vector<vector<size_t>> groups;
+  for (size_t i = 0; i < queries.size(); i++)
+  {
+    if (!queries[i].error.empty())
+    {
+      continue;
+    }
+    const FoodQuery& q = queries[i].query;
+    auto key = make_tuple(q.min_calories, q.max_calories, q.total_size, q.algorithm);
+    auto found = group_of.emplace(key, groups.size());
+    if (found.second)
+    {
+      groups.emplace_back();
+    }
+    groups[found.first->second].push_back(i);
+  }
+
+  vector<vector<FoodQuery>> group_queries(groups.size());
+  vector<double> costs(groups.size());
+  for (size_t g = 0; g < groups.size(); g++)
+  {
+    for (size_t i : groups[g])
+    {
+      group_queries[g].push_back(queries[i].query);
+    }
+    costs[g] = group_cost(group_queries[g]);
+  }
+  vector<size_t> order(groups.size());
+  for (size_t g = 0; g < order.size(); g++)
+  {
+    order[g] = g;
+  }
+  sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+  // Output rows, filled in by the workers and written here in order
+  vector<string> output(queries.size());
+  vector<bool> ready(queries.size(), false);
+  mutex output_mutex;
+  condition_variable output_ready;
+
+  auto format_row = [&](const BatchQuery& query, const FoodVector* answer, const string& error)
+  {
+    ostringstream row;
+    row << setprecision(15) << query.line << ",";
+    if (query.error.empty())
+    {
+      row << query.query.min_calories << "," << query.query.max_calories << ","
+          << query.query.total_size << "," << query.query.total_weight << ","
+          << csv_field(query.query.algorithm) << ",";
+    }
+    else
+    {
+      // The line did not parse
+      row << ",,,,,";
+    }
+    if (answer)
+    {
+      double weight, calories;
+      sum_food_vector(*answer, weight, calories);
+      row << answer->size() << "," << weight << "," << calories << ",";
+      for (size_t i = 0; i < answer->size(); i++)
+      {
+        row << (i ? " " : "") << rows.at((*answer)[i].get());
+      }
+      row << ",";
+    }
+    else
+    {
+      row << ",,,," << csv_field(error);
+    }
+    return row.str();
+  };
+
+  atomic<size_t> failed{0};
+  for (size_t i = 0; i < queries.size(); i++)
+  {
+    if (!queries[i].error.empty())
+    {
+      output[i] = format_row(queries[i], nullptr, queries[i].error);
+      ready[i] = true;
+      failed++;
+    }
+  }
+
+  ofstream out(out_path);
+  if (!out)
+  {
+    cout << "Cannot open " << out_path << endl;
+    return 1;
+  }
+  out << "line,min_calories,max_calories,total_size,total_weight,algorithm,count,weight,calories,items,error" << "\n";
+
+  WorkerPool pool(threads);
+  for (size_t g : order)
+  {
+    pool.submit([&, g]()
+    {
+      vector<string> formatted;
+      try
+      {
+        vector<unique_ptr<FoodVector>> answers;
+        vector<string> errors;
+        answer_food_query_group(index, group_queries[g], answers, errors);
+
+        for (size_t k = 0; k < groups[g].size(); k++)
+        {
+          formatted.push_back(format_row(queries[groups[g][k]], answers[k].get(), errors[k]));
+        }
+        for (size_t k = 0; k < groups[g].size(); k++)
+        {
+          failed += !answers[k];
+        }
+      }
+      catch (const exception& e)
+      {
+        // Such as bad_alloc; every row must still become ready, or the
+        // writer below waits forever
+        formatted.clear();
+        for (size_t i : groups[g])
+        {
+          formatted.push_back(format_row(queries[i], nullptr, string("solve failed: ") + e.what()));
+        }
+        failed += groups[g].size();
+      }
+
+      lock_guard<mutex> lock(output_mutex);
+      for (size_t k = 0; k < groups[g].size(); k++)
+      {
+        output[groups[g][k]] = move(formatted[k]);
+        ready[groups[g][k]] = true;
+      }
+      output_ready.notify_one();
+    });
+  }
+
+  for (size_t i = 0; i < queries.size(); i++)
+  {
+    string row;
+    {
+      unique_lock<mutex> lock(output_mutex);
+      output_ready.wait(lock, [&]() { return bool(ready[i]); });
+      row.swap(output[i]);
+    }
+    out << row << "\n";
+  }
+  out.close();
+
+  cout << "Answered " << queries.size() << " queries in " << groups.size() << " groups ("
+       << failed.load() << " failed) in " << timer.elapsed() << " s; wrote " << out_path << endl;
+  return 0;
+}
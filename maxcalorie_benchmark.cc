@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxcalorie_benchmark.cc
+//
+// Two-dimensional scaling benchmark: times every solver over log-spaced
+// grids of item counts n and capacities W, and writes one tidy CSV row per
+// measured cell:
+//
+//	algorithm,n,W,threads,median_s,peak_bytes
+//
+// Cells are run from small to large. Once an algorithm has been measured,
+// the cost constant (seconds per complexity_model operation) of its most
+// recent cell predicts the cost of the next cells, and cells predicted to
+// exceed the time or memory budget are skipped, so the whole grid finishes
+// within the budget. Solvers whose cost does not depend on W are measured
+// once per n, and that result is repeated across W.
+//
+// Usage: maxcalorie_benchmark [--out PATH] [--n-max N] [--w-min W]
+//	[--w-max W] [--per-decade K] [--trials T] [--budget SECONDS]
+//	[--cell-budget SECONDS] [--memory-budget BYTES]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+
+// Count heap allocations for peak_bytes
+#define ALLOCSTATS_REPLACE_OPERATOR_NEW
+#include "allocstats.hh"
+#include "benchmark.hh"
+#include "maxcalorie.hh"
+
+using namespace std;
+
+// Settings, from the command line.
+struct GridOptions
+{
+  string out = "benchmark_grid.csv";
+  int n_max = 4096;
+  int w_min = 10;
+  int w_max = 100000;
+  int per_decade = 3;
+  int trials = 5;
+  double budget = 120;
+  double cell_budget = 10;
+  double memory_budget = 1e9;
+};
+
+// One solver variant in the grid.
+struct GridSolver
+{
+  string algorithm;
+  // Largest n the solver accepts.
+  int n_limit;
+  // False when the cost does not depend on W.
+  bool uses_w;
+  // Predicted peak bytes for n items and capacity W.
+  function<double(int, int)> memory;
+  function<unique_ptr<FoodVector>(const FoodView&, int)> solve;
+};
+
+bool parse_options(int argc, char* argv[], GridOptions& options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    string flag = argv[i];
+    if (i + 1 >= argc)
+    {
+      cout << "Missing value for " << flag << endl;
+      return false;
+    }
+    string value = argv[++i];
+
+    if (flag == "--out") options.out = value;
+    else if (flag == "--n-max") options.n_max = atoi(value.c_str());
+    else if (flag == "--w-min") options.w_min = atoi(value.c_str());
+    else if (flag == "--w-max") options.w_max = atoi(value.c_str());
+    else if (flag == "--per-decade") options.per_decade = atoi(value.c_str());
+    else if (flag == "--trials") options.trials = atoi(value.c_str());
+    else if (flag == "--budget") options.budget = atof(value.c_str());
+    else if (flag == "--cell-budget") options.cell_budget = atof(value.c_str());
+    else if (flag == "--memory-budget") options.memory_budget = atof(value.c_str());
+    else
+    {
+      cout << "Unknown option " << flag << endl;
+      return false;
+    }
+  }
+
+  if (options.n_max < 1 || options.w_min < 1 || options.w_max < options.w_min || options.per_decade < 1 || options.trials < 1)
+  {
+    cout << "Invalid grid options" << endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  GridOptions options;
+  if (!parse_options(argc, argv, options))
+  {
+    return 1;
+  }
+
+  auto all_foods = load_food_database("food.csv");
+  if (!all_foods)
+  {
+    return 1;
+  }
+  auto filtered_foods = filter_food_view(*all_foods, 1, 2500, all_foods->size());
+  options.n_max = min<int>(options.n_max, filtered_foods->size());
+
+  vector<GridSolver> solvers = {
+    {
+      "exhaustive", 30, false,
+      [](int n, int) { return 16.0 * n; },
+      [](const FoodView& foods, int W) { return exhaustive_max_calories(foods, W); }
+    },
+    {
+      "dynamic", options.n_max, true,
+      [](int n, int W) { return 8.0 * (n + 1) * (W + 1.0); },
+      [](const FoodView& foods, int W) { return dynamic_max_calories(foods, W); }
+    },
+  };
+
+  BenchmarkOptions benchmark_options;
+  benchmark_options.warmup = 1;
+  benchmark_options.trials = options.trials;
+  benchmark_options.memory = true;
+  BenchmarkSuite suite(benchmark_options);
+  const int runs_per_cell = benchmark_options.warmup + benchmark_options.trials + 1;
+
+  ofstream out(options.out);
+  out << "algorithm,n,W,threads,median_s,peak_bytes" << endl;
+
+  const vector<int> ns = log_spaced(1, options.n_max, options.per_decade);
+  const vector<int> ws = log_spaced(options.w_min, options.w_max, options.per_decade);
+
+  Timer total;
+  size_t measured = 0, skipped = 0;
+  for (auto& solver : solvers)
+  {
+    // Seconds per model operation of the most recent measured cell. The
+    // largest seen so far would come from the smallest cells, which are
+    // mostly fixed overhead, and overstate every later cell.
+    double constant = 0;
+
+    for (int n : ns)
+    {
+      // This n's result, once measured, when the cost does not depend on W
+      bool have_result = false;
+      double median = 0;
+      uint64_t peak_bytes = 0;
+
+      for (int W : ws)
+      {
+        if (n > solver.n_limit)
+        {
+          skipped++;
+          continue;
+        }
+
+        if (!have_result)
+        {
+          double predicted = constant * complexity_model(solver.algorithm, n, W) * runs_per_cell;
+          double remaining = options.budget - total.elapsed();
+          if (predicted > options.cell_budget || predicted > remaining || solver.memory(n, W) > options.memory_budget)
+          {
+            skipped++;
+            continue;
+          }
+
+          FoodView foods = filtered_foods->prefix(n);
+          const BenchmarkResult& result = suite.run(solver.algorithm, n, W, [&]() { return solver.solve(foods, W); });
+          median = result.median;
+          peak_bytes = result.memory.peak_heap_bytes;
+          constant = median / complexity_model(solver.algorithm, n, W);
+          measured++;
+          have_result = !solver.uses_w;
+        }
+
+        out
+          << solver.algorithm << ","
+          << n << ","
+          << W << ","
+          << 1 << ","
+          << fixed << setprecision(10) << median << defaultfloat << ","
+          << peak_bytes
+          << endl;
+      }
+    }
+  }
+  out.close();
+
+  cout
+    << "Measured " << measured << " cells, skipped " << skipped
+    << ", in " << total.elapsed() << " seconds; wrote " << options.out
+    << endl;
+  return 0;
+}
@@ -0,0 +1,309 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxcalorie_fuzz.cc
+//
+// Differential fuzzer: solves small random instances with every registered
+// solver and checks each answer against exhaustive_max_calories. An answer
+// must be feasible (distinct foods from the instance, within the total
+// weight) and reach the same optimal calories. About a third of the
+// instances have fractional weights and calories; a solver that refuses
+// an instance (see food_solver_accepts_weight and food_solver_accepts_foods)
+// must return no answer for it rather than a wrong one.
+//
+// A failing instance is minimized (foods removed and the total weight
+// lowered while it still fails) and written as a food.csv-format file,
+// fuzz_SOLVER_seedSEED_wW.csv, that reproduces the failure.
+//
+// Usage: maxcalorie_fuzz [--seed SEED] [--iterations N] [--max-n N]
+//	[--max-weight W] [--out-dir DIR]
+//	maxcalorie_fuzz --replay FILE W
+//
+// Instance i is generated from seed SEED + i, so a failure reported for
+// seed S reproduces with --seed S --iterations 1. --replay checks every
+// solver against the foods in FILE (at most 30) with total weight W, as
+// written for a failure.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "food_generator.hh"
+#include "maxcalorie.hh"
+
+using namespace std;
+
+// Why solver's answer for foods and total_weight is wrong, or an empty
+// string when it matches the exhaustive optimum.
+string check_solver(const FoodSolver& solver, const FoodVector& foods, double total_weight)
+{
+  string refusal;
+  const bool accepted = food_solver_accepts_weight(solver, total_weight, refusal)
+    && food_solver_accepts_foods(solver, foods, refusal);
+
+  unique_ptr<FoodVector> solution;
+  try
+  {
+    solution = solver.solve(foods, total_weight);
+  }
+  catch (const exception& e)
+  {
+    return string("threw ") + e.what();
+  }
+  if (!accepted)
+  {
+    return solution ? "answered an instance it refuses (" + refusal + ")" : "";
+  }
+  if (!solution)
+  {
+    return "returned no solution";
+  }
+
+  double expected_weight, expected_calories;
+  sum_food_vector(*exhaustive_max_calories(foods, total_weight), expected_weight, expected_calories);
+
+  set<const FoodItem*> available, chosen;
+  for (auto& food : foods)
+  {
+    available.insert(food.get());
+  }
+  for (auto& food : *solution)
+  {
+    if (!available.count(food.get()))
+    {
+      return "chose a food that is not in the instance";
+    }
+    if (!chosen.insert(food.get()).second)
+    {
+      return "chose the same food twice";
+    }
+  }
+
+  double weight, calories;
+  sum_food_vector(*solution, weight, calories);
+  stringstream ss;
+  if (weight > total_weight + 1e-9)
+  {
+    ss << "weight " << weight << " exceeds " << total_weight;
+  }
+  else if (abs(calories - expected_calories) > 1e-6 * max(1.0, expected_calories))
+  {
+    ss << "found " << calories << " calories, optimum is " << expected_calories;
+  }
+  return ss.str();
+}
+
+// Shrink a failing instance: drop every food whose removal keeps it
+// failing, then lower total_weight as far as it keeps failing.
+void minimize(const FoodSolver& solver, FoodVector& foods, double& total_weight)
+{
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i = 0; i < foods.size(); )
+    {
+      FoodVector smaller(foods);
+      smaller.erase(smaller.begin() + i);
+      if (!check_solver(solver, smaller, total_weight).empty())
+      {
+        foods.swap(smaller);
+        changed = true;
+      }
+      else
+      {
+        i++;
+      }
+    }
+
+    for (double step = floor(total_weight / 2); step >= 1; step = floor(step / 2))
+    {
+      while (total_weight - step >= 0 && !check_solver(solver, foods, total_weight - step).empty())
+      {
+        total_weight -= step;
+        changed = true;
+      }
+    }
+  }
+}
+
+// Write foods in the food.csv format.
+bool write_food_csv(const FoodVector& foods, const string& path)
+{
+  ofstream out(path);
+  if (!out)
+  {
+    cout << "Cannot open " << path << endl;
+    return false;
+  }
+  out << "Item^Weight^foodCalories" << "\n" << setprecision(17);
+  for (auto& food : foods)
+  {
+    out << food->description() << "^" << food->weight() << "^" << food->foodCalories() << "\n";
+  }
+  return bool(out);
+}
+
+// Give each food a random fractional part in its weight and calories,
+// each with probability one half.
+unique_ptr<FoodVector> make_fractional(const FoodVector& foods, FoodRandom& random)
+{
+  auto fractional = make_unique<FoodVector>();
+  for (auto& food : foods)
+  {
+    double weight = food->weight(), calories = food->foodCalories();
+    if (random.between(0, 1))
+    {
+      weight += random.uniform();
+    }
+    if (random.between(0, 1))
+    {
+      calories += random.uniform();
+    }
+    fractional->push_back(make_shared<FoodItem>(food->description(), weight, calories));
+  }
+  return fractional;
+}
+
+// Check every solver against the foods in path with total_weight, as
+// written for a failure. Returns the number of solvers that fail.
+int replay(const string& path, double total_weight)
+{
+  auto foods = load_food_database(path);
+  if (!foods)
+  {
+    return 1;
+  }
+  const FoodSolver* exhaustive = find_food_solver("exhaustive");
+  if (foods->size() > exhaustive->max_size)
+  {
+    cout << path << " has " << foods->size() << " foods, more than exhaustive handles" << endl;
+    return 1;
+  }
+
+  int failures = 0;
+  for (auto& solver : food_solver_registry())
+  {
+    if (solver.name == "exhaustive" || foods->size() > solver.max_size)
+    {
+      continue;
+    }
+    string error = check_solver(solver, *foods, total_weight);
+    cout << solver.name << ": " << (error.empty() ? "ok" : error) << endl;
+    failures += !error.empty();
+  }
+  return failures;
+}
+
+int main(int argc, char* argv[])
+{
+  uint64_t seed = 1;
+  uint64_t iterations = 1000;
+  int max_n = 16;
+  int max_weight = 1000;
+  string out_dir = ".";
+
+  for (int i = 1; i < argc; i += 2)
+  {
+    string flag = argv[i];
+    if (i + 1 >= argc)
+    {
+      cout << "Missing value for " << flag << endl;
+      return 2;
+    }
+    string value = argv[i + 1];
+
+    if (flag == "--seed") seed = strtoull(value.c_str(), nullptr, 10);
+    else if (flag == "--iterations") iterations = strtoull(value.c_str(), nullptr, 10);
+    else if (flag == "--max-n") max_n = atoi(value.c_str());
+    else if (flag == "--max-weight") max_weight = atoi(value.c_str());
+    else if (flag == "--out-dir") out_dir = value;
+    else if (flag == "--replay")
+    {
+      if (i + 2 >= argc)
+      {
+        cout << "--replay needs FILE and W" << endl;
+        return 2;
+      }
+      return replay(value, strtod(argv[i + 2], nullptr)) ? 1 : 0;
+    }
+    else
+    {
+      cout << "Invalid option " << flag << endl;
+      return 2;
+    }
+  }
+  if (max_n < 0 || max_n > 30 || max_weight < 1)
+  {
+    cout << "--max-n must be in [0, 30] and --max-weight at least 1" << endl;
+    return 2;
+  }
+
+  const FoodCorrelation correlations[] = {
+    FoodCorrelation::UNCORRELATED, FoodCorrelation::WEAKLY_CORRELATED,
+    FoodCorrelation::STRONGLY_CORRELATED, FoodCorrelation::SUBSET_SUM
+  };
+
+  uint64_t failures = 0;
+  for (uint64_t iteration = 0; iteration < iterations; iteration++)
+  {
+    // Draw the instance shape, then the instance, from this case's seed
+    const uint64_t case_seed = seed + iteration;
+    FoodRandom random(case_seed);
+    FoodGeneratorOptions options;
+    options.seed = case_seed;
+    options.n = random.between(0, max_n);
+    options.max_weight = random.between(1, max_weight);
+    options.correlation = correlations[random.between(0, 3)];
+    options.weight_distribution = random.between(0, 1) ? FoodWeightDistribution::LOG_UNIFORM : FoodWeightDistribution::UNIFORM;
+    options.duplicate_rate = random.between(0, 1) ? 0.3 : 0;
+
+    auto foods = generate_food_vector(options);
+    const bool fractional = random.between(0, 2) == 0;
+    if (fractional)
+    {
+      foods = make_fractional(*foods, random);
+    }
+    double weight_sum, calorie_sum;
+    sum_food_vector(*foods, weight_sum, calorie_sum);
+    double total_weight = random.between(0, int64_t(weight_sum));
+    if (fractional && random.between(0, 1))
+    {
+      total_weight += random.uniform();
+    }
+
+    for (auto& solver : food_solver_registry())
+    {
+      if (solver.name == "exhaustive" || foods->size() > solver.max_size)
+      {
+        continue;
+      }
+
+      string error = check_solver(solver, *foods, total_weight);
+      if (error.empty())
+      {
+        continue;
+      }
+
+      failures++;
+      FoodVector small(*foods);
+      double small_weight = total_weight;
+      minimize(solver, small, small_weight);
+
+      stringstream weight, path;
+      weight << setprecision(17) << small_weight;
+      path << out_dir << "/fuzz_" << solver.name << "_seed" << case_seed << "_w" << weight.str() << ".csv";
+      write_food_csv(small, path.str());
+      cout << solver.name << " failed on seed " << case_seed << ": " << error << endl
+           << "  minimized to " << small.size() << " foods, total weight " << weight.str()
+           << ": " << check_solver(solver, small, small_weight) << endl
+           << "  wrote " << path.str() << "; rerun with --replay " << path.str() << " " << weight.str() << endl;
+    }
+  }
+
+  cout << iterations << " instances, " << failures << " failures" << endl;
+  return failures ? 1 : 0;
+}
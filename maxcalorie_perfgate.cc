@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxcalorie_perfgate.cc
+//
+// Performance gate: fits each algorithm's complexity model to benchmark
+// timings, prints the fitted constants and R^2, and compares the constants
+// with a stored baseline. Exits with status 1 when any constant is more
+// than the threshold factor above its baseline, so it can fail a build.
+//
+// Usage: maxcalorie_perfgate [--baseline PATH] [--threshold [ALGORITHM=]FACTOR]...
+//	[--w W] [--update-baseline] DATA...
+//
+// The threshold is 1.25 by default and 1.5 for dynamic, whose fit is the
+// noisier (R^2 near 0.9, and single runs spread by a third); --threshold
+// FACTOR changes the default and --threshold ALGORITHM=FACTOR one
+// algorithm's.
+//
+// Each DATA is either a tidy CSV from maxcalorie_benchmark, or
+// ALGORITHM=PATH for an n,seconds scatterplot CSV measured at capacity W
+// (default 2000), e.g. exhaustive=exhaustive.csv. Each DATA is fitted on
+// its own; when several measure the same algorithm (repeated runs), the
+// median constant is used, so one noisy run neither fails the gate nor
+// skews a new baseline.
+//
+// The baseline is a CSV of algorithm,constant,r_squared rows;
+// --update-baseline rewrites it from the current fits instead of
+// comparing.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "benchmark.hh"
+
+using namespace std;
+
+// Read algorithm -> constant from a baseline CSV.
+bool read_baseline(const string& path, map<string, double>& constants)
+{
+  ifstream f(path);
+  string line;
+  if (!f || !getline(f, line))
+  {
+    cout << "Failed to read baseline; cannot open file: " << path << endl;
+    return false;
+  }
+  while (getline(f, line))
+  {
+    stringstream ss(line);
+    string algorithm, constant;
+    if (getline(ss, algorithm, ',') && getline(ss, constant, ','))
+    {
+      constants[algorithm] = atof(constant.c_str());
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  string baseline_path = "perf_baseline.csv";
+  double threshold = 1.25;
+  map<string, double> thresholds = { { "dynamic", 1.5 } };
+  double total_weight = 2000;
+  bool update_baseline = false;
+  // The timings of each DATA argument
+  vector<vector<TimingPoint>> runs;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    if (arg == "--update-baseline")
+    {
+      update_baseline = true;
+    }
+    else if ((arg == "--baseline" || arg == "--threshold" || arg == "--w") && i + 1 < argc)
+    {
+      string value = argv[++i];
+      if (arg == "--baseline") baseline_path = value;
+      else if (arg == "--threshold")
+      {
+        size_t equals = value.find('=');
+        if (equals == string::npos) threshold = atof(value.c_str());
+        else thresholds[value.substr(0, equals)] = atof(value.c_str() + equals + 1);
+      }
+      else total_weight = atof(value.c_str());
+    }
+    else
+    {
+      size_t equals = arg.find('=');
+      string algorithm = equals == string::npos ? "" : arg.substr(0, equals);
+      string path = equals == string::npos ? arg : arg.substr(equals + 1);
+      runs.emplace_back();
+      if (!read_timing_csv(path, algorithm, total_weight, runs.back()))
+      {
+        return 2;
+      }
+    }
+  }
+
+  bool thresholds_valid = threshold > 0;
+  for (auto& entry : thresholds)
+  {
+    thresholds_valid = thresholds_valid && entry.second > 0;
+  }
+  if (runs.empty() || !thresholds_valid)
+  {
+    cout << "Usage: maxcalorie_perfgate [--baseline PATH] [--threshold [ALGORITHM=]FACTOR]... [--w W] [--update-baseline] DATA..." << endl;
+    return 2;
+  }
+
+  vector<string> algorithms;
+  for (auto& run : runs)
+  {
+    for (auto& point : run)
+    {
+      if (find(algorithms.begin(), algorithms.end(), point.algorithm) == algorithms.end())
+      {
+        algorithms.push_back(point.algorithm);
+      }
+    }
+  }
+
+  vector<ComplexityFit> fits;
+  for (auto& algorithm : algorithms)
+  {
+    vector<ComplexityFit> run_fits;
+    for (auto& run : runs)
+    {
+      ComplexityFit fit = fit_complexity(algorithm, run);
+      if (fit.points > 0)
+      {
+        run_fits.push_back(fit);
+      }
+    }
+    if (run_fits.empty())
+    {
+      cout << algorithm << ": no complexity model, skipped" << endl;
+      continue;
+    }
+
+    // The median run, taking the upper one of an even count
+    sort(run_fits.begin(), run_fits.end(), [](const ComplexityFit& a, const ComplexityFit& b) { return a.constant < b.constant; });
+    const ComplexityFit& fit = run_fits[run_fits.size() / 2];
+    cout
+      << algorithm << ": constant = " << scientific << setprecision(4) << fit.constant
+      << " s/op, R^2 = " << fixed << setprecision(4) << fit.r_squared
+      << " over " << fit.points << " points";
+    if (run_fits.size() > 1)
+    {
+      cout
+        << ", median of " << run_fits.size() << " runs from "
+        << scientific << setprecision(4) << run_fits.front().constant << " to " << run_fits.back().constant;
+    }
+    cout << endl;
+    fits.push_back(fit);
+  }
+
+  if (update_baseline)
+  {
+    ofstream out(baseline_path);
+    out << "algorithm,constant,r_squared" << endl;
+    for (auto& fit : fits)
+    {
+      out << fit.algorithm << "," << scientific << setprecision(6) << fit.constant << "," << fixed << setprecision(6) << fit.r_squared << endl;
+    }
+    cout << "Wrote baseline " << baseline_path << endl;
+    return 0;
+  }
+
+  map<string, double> baseline;
+  if (!read_baseline(baseline_path, baseline))
+  {
+    return 2;
+  }
+
+  bool regressed = false;
+  for (auto& fit : fits)
+  {
+    auto found = baseline.find(fit.algorithm);
+    if (found == baseline.end())
+    {
+      cout << fit.algorithm << ": not in baseline" << endl;
+      continue;
+    }
+    double ratio = fit.constant / found->second;
+    auto own = thresholds.find(fit.algorithm);
+    double limit = own == thresholds.end() ? threshold : own->second;
+    bool failed = !(ratio <= limit);
+    cout
+      << fit.algorithm << ": " << fixed << setprecision(3) << ratio << "x baseline, limit " << limit << "x"
+      << (failed ? " -- REGRESSION" : " -- ok") << endl;
+    regressed = regressed || failed;
+  }
+
+  return regressed ? 1 : 0;
+}
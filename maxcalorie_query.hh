@@ -0,0 +1,460 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxcalorie_query.hh
+//
+// A knapsack query against a resident food database: which foods to
+// filter, the total weight one can carry, and which registered solver to
+// use. Shared by the long-running tools so that they parse and answer
+// queries the same way.
+//
+// The text form of a query is
+//
+//	MIN_CALORIES MAX_CALORIES TOTAL_SIZE TOTAL_WEIGHT [ALGORITHM]
+//
+// separated by spaces, with ALGORITHM defaulting to "dynamic".
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "maxcalorie.hh"
+
+
+struct FoodQuery
+{
+	double min_calories = 0;
+	double max_calories = 0;
+	int total_size = 0;
+	double total_weight = 0;
+	std::string algorithm = "dynamic";
+};
+
+
+// Bounds on the queries a tool accepts. The dynamic programming solvers
+// keep a table row of TOTAL_WEIGHT + 1 entries per food, so an unbounded
+// capacity lets one query exhaust memory.
+struct FoodQueryLimits
+{
+	// Largest TOTAL_WEIGHT accepted; never above INT_MAX.
+	double max_total_weight = 1000000;
+};
+
+
+// Parse the text form of a query, rejecting capacities that are not
+// finite, are negative, or exceed limits. On failure returns false and
+// describes the problem in error.
+bool parse_food_query
+(
+	const std::string& text,
+	FoodQuery& query,
+	std::string& error,
+	const FoodQueryLimits& limits = FoodQueryLimits()
+)
+{
+	std::istringstream ss(text);
+	FoodQuery parsed;
+	if (!(ss >> parsed.min_calories >> parsed.max_calories >> parsed.total_size >> parsed.total_weight))
+	{
+		error = "expected MIN_CALORIES MAX_CALORIES TOTAL_SIZE TOTAL_WEIGHT [ALGORITHM]";
+		return false;
+	}
+	std::string extra;
+	if (ss >> parsed.algorithm && ss >> extra)
+	{
+		error = "unexpected text after the algorithm: " + extra;
+		return false;
+	}
+	if (parsed.total_size <= 0 || !(parsed.total_weight >= 0))
+	{
+		error = "total size must be positive and total weight non-negative";
+		return false;
+	}
+	double max_total_weight = std::min<double>(limits.max_total_weight, INT_MAX);
+	if (!std::isfinite(parsed.total_weight) || parsed.total_weight > max_total_weight)
+	{
+		std::ostringstream ss;
+		ss << "total weight must be at most " << std::fixed << std::setprecision(0) << max_total_weight;
+		error = ss.str();
+		return false;
+	}
+	
+	query = parsed;
+	return true;
+}
+
+
+// Filter the indexed database and solve query with the requested solver,
+// under control when given. On failure returns nullptr and describes the
+// problem in error. *proven_optimal (if given) is set to false when
+// control stopped the solve early.
+std::unique_ptr<FoodVector> answer_food_query
+(
+	const FoodCalorieIndex& index,
+	const FoodQuery& query,
+	std::string& error,
+	const SolveControl* control = nullptr,
+	bool* proven_optimal = nullptr
+)
+{
+	if (proven_optimal)
+	{
+		*proven_optimal = true;
+	}
+
+	const FoodSolver* solver = find_food_solver(query.algorithm);
+	if (!solver)
+	{
+		error = "unknown algorithm: " + query.algorithm;
+		return nullptr;
+	}
+	if (query.total_size <= 0)
+	{
+		error = "total size must be positive";
+		return nullptr;
+	}
+	if (!food_solver_accepts_weight(*solver, query.total_weight, error))
+	{
+		return nullptr;
+	}
+	
+	auto foods = index.filter_view(query.min_calories, query.max_calories, query.total_size);
+	if (foods->size() > solver->max_size)
+	{
+		std::ostringstream ss;
+		ss << query.algorithm << " handles at most " << solver->max_size << " foods, the filter matched " << foods->size();
+		error = ss.str();
+		return nullptr;
+	}
+	if (!food_solver_accepts_foods(*solver, *foods, error))
+	{
+		return nullptr;
+	}
+	
+	if (!control)
+	{
+		return solver->solve(*foods, query.total_weight);
+	}
+	SolveResult result = run_food_solver(*solver, *foods, query.total_weight, *control);
+	if (proven_optimal)
+	{
+		*proven_optimal = result.proven_optimal;
+	}
+	return std::move(result.foods);
+}
+
+
+// True when a and b filter the database the same way and use the same
+// algorithm, so that they can be answered together by
+// answer_food_query_group.
+bool same_food_query_group(const FoodQuery& a, const FoodQuery& b)
+{
+	return a.min_calories == b.min_calories
+		&& a.max_calories == b.max_calories
+		&& a.total_size == b.total_size
+		&& a.algorithm == b.algorithm
+		;
+}
+
+// Answer queries that all belong to one group (see same_food_query_group),
+// filtering once. Solvers with solve_capacities, such as dynamic
+// programming, answer the whole group at once; others solve each query in
+// turn. answers[i] is the answer to queries[i], or
+// nullptr with errors[i] describing the problem.
+void answer_food_query_group
+(
+	const FoodCalorieIndex& index,
+	const std::vector<FoodQuery>& queries,
+	std::vector<std::unique_ptr<FoodVector>>& answers,
+	std::vector<std::string>& errors
+)
+{
+	answers.clear();
+	answers.resize(queries.size());
+	errors.assign(queries.size(), std::string());
+	if (queries.empty())
+	{
+		return;
+	}
+	
+	const FoodQuery& first = queries[0];
+	const FoodSolver* solver = find_food_solver(first.algorithm);
+	std::string error;
+	if (!solver)
+	{
+		error = "unknown algorithm: " + first.algorithm;
+	}
+	else if (first.total_size <= 0)
+	{
+		error = "total size must be positive";
+	}
+	if (!error.empty())
+	{
+		errors.assign(queries.size(), error);
+		return;
+	}
+	
+	auto foods = index.filter_view(first.min_calories, first.max_calories, first.total_size);
+	if (foods->size() > solver->max_size)
+	{
+		std::ostringstream ss;
+		ss << first.algorithm << " handles at most " << solver->max_size << " foods, the filter matched " << foods->size();
+		errors.assign(queries.size(), ss.str());
+		return;
+	}
+	if (!food_solver_accepts_foods(*solver, *foods, error))
+	{
+		errors.assign(queries.size(), error);
+		return;
+	}
+	
+	// Queries the solver cannot take fail on their own
+	std::vector<bool> accepted(queries.size());
+	for (size_t i = 0; i < queries.size(); i++)
+	{
+		accepted[i] = food_solver_accepts_weight(*solver, queries[i].total_weight, errors[i]);
+	}
+	
+	if (solver->solve_capacities)
+	{
+		std::vector<size_t> members;
+		std::vector<double> total_weights;
+		for (size_t i = 0; i < queries.size(); i++)
+		{
+			if (accepted[i])
+			{
+				members.push_back(i);
+				total_weights.push_back(queries[i].total_weight);
+			}
+		}
+		auto shared = solver->solve_capacities(*foods, total_weights);
+		for (size_t k = 0; k < members.size(); k++)
+		{
+			answers[members[k]] = std::move(shared[k]);
+		}
+		return;
+	}
+	
+	for (size_t i = 0; i < queries.size(); i++)
+	{
+		if (accepted[i])
+		{
+			answers[i] = solver->solve(*foods, queries[i].total_weight);
+		}
+	}
+}
+
+
+// A least-recently-used cache of query answers, keyed by the query and the
+// generation of the FoodCalorieIndex it was answered against. Answers for
+// an older generation are dropped as soon as a newer generation is seen,
+// so the cache is meant to serve one index at a time.
+// The cache holds at most max_bytes of entries, estimated from their
+// sizes. It is safe to share between threads.
+class FoodQueryCache
+{
+	//
+	public:
+		explicit FoodQueryCache(size_t max_bytes = 64 * 1024 * 1024) : _max_bytes(max_bytes) { }
+		
+		// The answer to query, from the cache when present, and otherwise
+		// from answer_food_query (under control, when given), then cached.
+		// On failure returns nullptr and describes the problem in error.
+		// Failures and answers not proven optimal (see answer_food_query)
+		// are not cached.
+		std::shared_ptr<const FoodVector> answer
+		(
+			const FoodCalorieIndex& index,
+			const FoodQuery& query,
+			std::string& error,
+			const SolveControl* control = nullptr,
+			bool* proven_optimal = nullptr
+		)
+		{
+			if (proven_optimal)
+			{
+				*proven_optimal = true;
+			}
+			Key key = make_key(query, index.generation());
+			if (auto cached = find(key))
+			{
+				return cached;
+			}
+			
+			bool proven = true;
+			std::shared_ptr<const FoodVector> solution(answer_food_query(index, query, error, control, &proven));
+			if (solution && proven)
+			{
+				insert(key, solution);
+			}
+			if (proven_optimal)
+			{
+				*proven_optimal = proven;
+			}
+			return solution;
+		}
+		
+		// Drop every entry.
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_entries.clear();
+			_lookup.clear();
+			_bytes = 0;
+		}
+		
+		uint64_t hits() const { std::lock_guard<std::mutex> lock(_mutex); return _hits; }
+		uint64_t misses() const { std::lock_guard<std::mutex> lock(_mutex); return _misses; }
+		size_t size() const { std::lock_guard<std::mutex> lock(_mutex); return _entries.size(); }
+		size_t bytes() const { std::lock_guard<std::mutex> lock(_mutex); return _bytes; }
+		size_t max_bytes() const { return _max_bytes; }
+	
+	//
+	private:
+		// The canonical form of a query: bit patterns of the numbers (with
+		// -0 folded into 0), the algorithm name and the generation.
+		struct Key
+		{
+			uint64_t min_calories, max_calories, total_weight;
+			int total_size;
+			std::string algorithm;
+			uint64_t generation;
+			
+			bool operator==(const Key& other) const
+			{
+				return min_calories == other.min_calories
+					&& max_calories == other.max_calories
+					&& total_weight == other.total_weight
+					&& total_size == other.total_size
+					&& algorithm == other.algorithm
+					&& generation == other.generation
+					;
+			}
+		};
+		
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const
+			{
+				uint64_t h = std::hash<std::string>()(key.algorithm);
+				for (uint64_t field : { key.min_calories, key.max_calories, key.total_weight, uint64_t(key.total_size), key.generation })
+				{
+					h = (h ^ field) * 0x100000001B3ULL;
+					h ^= h >> 29;
+				}
+				return h;
+			}
+		};
+		
+		struct Entry
+		{
+			Key key;
+			std::shared_ptr<const FoodVector> solution;
+			size_t bytes;
+		};
+		
+		static uint64_t bits(double x)
+		{
+			if (x == 0)
+			{
+				x = 0;
+			}
+			uint64_t result;
+			std::memcpy(&result, &x, sizeof(result));
+			return result;
+		}
+		
+		static Key make_key(const FoodQuery& query, uint64_t generation)
+		{
+			return Key{
+				bits(query.min_calories), bits(query.max_calories), bits(query.total_weight),
+				query.total_size, query.algorithm, generation
+			};
+		}
+		
+		// Estimated memory held by an entry, including the map node.
+		static size_t entry_bytes(const Entry& entry)
+		{
+			return sizeof(Entry) + 4 * sizeof(void*) + entry.key.algorithm.capacity()
+				+ sizeof(FoodVector) + entry.solution->capacity() * sizeof(FoodVector::value_type);
+		}
+		
+		std::shared_ptr<const FoodVector> find(const Key& key)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			forget_older_generations(key.generation);
+			auto found = _lookup.find(key);
+			if (found == _lookup.end())
+			{
+				_misses++;
+				return nullptr;
+			}
+			_hits++;
+			_entries.splice(_entries.begin(), _entries, found->second);
+			return found->second->solution;
+		}
+		
+		void insert(const Key& key, const std::shared_ptr<const FoodVector>& solution)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			forget_older_generations(key.generation);
+			if (key.generation < _generation || _lookup.count(key))
+			{
+				return;
+			}
+			
+			Entry entry{ key, solution, 0 };
+			entry.bytes = entry_bytes(entry);
+			if (entry.bytes > _max_bytes)
+			{
+				return;
+			}
+			while (_bytes + entry.bytes > _max_bytes)
+			{
+				evict(std::prev(_entries.end()));
+			}
+			_entries.push_front(std::move(entry));
+			_lookup.emplace(_entries.front().key, _entries.begin());
+			_bytes += _entries.front().bytes;
+		}
+		
+		void forget_older_generations(uint64_t generation)
+		{
+			if (generation > _generation)
+			{
+				_entries.clear();
+				_lookup.clear();
+				_bytes = 0;
+				_generation = generation;
+			}
+		}
+		
+		void evict(std::list<Entry>::iterator entry)
+		{
+			_bytes -= entry->bytes;
+			_lookup.erase(entry->key);
+			_entries.erase(entry);
+		}
+		
+		const size_t _max_bytes;
+		
+		mutable std::mutex _mutex;
+		// Most recently used first
+		std::list<Entry> _entries;
+		std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _lookup;
+		size_t _bytes = 0;
+		uint64_t _generation = 0;
+		uint64_t _hits = 0, _misses = 0;
+};
@@ -2,47 +2,105 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <string>
 
+// Count heap allocations for the memory columns
+#define ALLOCSTATS_REPLACE_OPERATOR_NEW
+#include "allocstats.hh"
+#include "benchmark.hh"
 #include "maxcalorie.hh"
-#include "timer.hh"
 
 using namespace std;
 
-int main()
+// Write the median time and the memory of each of suite's results for
+// algorithm as the scatterplot data in path.
+void write_scatterplot(const BenchmarkSuite& suite, const string& algorithm, const string& path)
 {
-  ofstream exhaustive("exhaustive.csv");
-  exhaustive << "n,seconds" << endl;
-  exhaustive << fixed << setprecision(10);
+  ofstream out(path);
+  out << "n,seconds,allocations,peak_heap_bytes,peak_rss_bytes" << endl;
+  out << fixed << setprecision(10);
+  for (auto& result : suite.results())
+  {
+    if (result.algorithm == algorithm)
+    {
+      out
+        << result.n << "," << result.median << ","
+        << result.memory.allocations << ","
+        << result.memory.peak_heap_bytes << ","
+        << result.memory.peak_rss_bytes
+        << endl;
+    }
+  }
+  out.close();
+}
+
+int main(int argc, char* argv[])
+{
+  // --counters also records hardware performance counters per trial;
+  // --out-dir DIR writes the CSVs to DIR instead of the current directory
+  BenchmarkOptions options;
+  options.memory = true;
+  string out_dir = ".";
+  for (int i = 1; i < argc; i++)
+  {
+    if (string(argv[i]) == "--counters")
+    {
+      options.counters = true;
+    }
+    else if (string(argv[i]) == "--out-dir" && i + 1 < argc)
+    {
+      out_dir = argv[++i];
+    }
+  }
 
   auto all_foods = load_food_database("food.csv");
   auto filtered_foods = filter_food_vector(*all_foods, 1, 2500, all_foods->size());
-    
+  FoodCalorieIndex filtered_index(*filtered_foods);
+
+  BenchmarkSuite suite(options);
+
   for(int i = 0; i < 22; i++)
   {
     int n = i + 1;
-    auto small_foods = filter_food_vector(*filtered_foods, 1, 2000, n);
+    auto small_foods = filtered_index.filter_view(1, 2000, n);
 
-    Timer timer;
-    auto solution = exhaustive_max_calories(*small_foods, 2000);
-    exhaustive << n << "," << timer.elapsed() << endl;
+    suite.run("exhaustive", n, 2000, [&]() { return exhaustive_max_calories(*small_foods, 2000); });
   }
-  exhaustive.close();
-    
-  ofstream dynamic("dynamic.csv");
-  dynamic << "n,seconds" << endl;
-  dynamic << fixed << setprecision(10);
-
- 
 
   for(int i = 0; i < 200; i++)
   {
     int n = i + 1;
-    auto small_foods = filter_food_vector(*filtered_foods, 1, 2000, n);
+    auto small_foods = filtered_index.filter_view(1, 2000, n);
 
-    Timer timer;
-    auto solution = dynamic_max_calories(*small_foods, 2000);
-    dynamic << n << "," << timer.elapsed() << endl;
+    suite.run("dynamic", n, 2000, [&]() { return dynamic_max_calories(*small_foods, 2000); });
   }
-  dynamic.close();
 
+  write_scatterplot(suite, "exhaustive", out_dir + "/exhaustive.csv");
+  write_scatterplot(suite, "dynamic", out_dir + "/dynamic.csv");
+
+  // One pass per algorithm gives the optimum and the incremental cost of
+  // every prefix, without re-solving the shorter ones.
+  ofstream sweep(out_dir + "/sweep.csv");
+  sweep << "algorithm,n,calories,step_seconds,elapsed_seconds" << endl;
+  sweep << fixed << setprecision(10);
+  auto write_sweep_point = [&](const string& algorithm, const SweepPoint& point)
+  {
+    sweep
+      << algorithm << "," << point.n << "," << point.calories << ","
+      << point.step_seconds << "," << point.elapsed_seconds
+      << endl;
+  };
+  auto exhaustive_foods = filtered_index.filter_view(1, 2000, 22);
+  exhaustive_max_calories_sweep(*exhaustive_foods, 2000, [&](const SweepPoint& point) { write_sweep_point("exhaustive", point); });
+  auto dynamic_foods = filtered_index.filter_view(1, 2000, 200);
+  dynamic_max_calories_sweep(*dynamic_foods, 2000, [&](const SweepPoint& point) { write_sweep_point("dynamic", point); });
+  sweep.close();
+
+  ofstream summary(out_dir + "/benchmark_summary.csv");
+  suite.write_summary_csv(summary);
+  summary.close();
+
+  ofstream samples(out_dir + "/benchmark_samples.csv");
+  suite.write_samples_csv(samples);
+  samples.close();
 }
@@ -0,0 +1,430 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxcalorie_server.cc
+//
+// Query server: loads the food database once, keeps it resident, and
+// answers knapsack queries over a Unix domain socket. The main thread
+// polls the socket and every connection, and hands each request line to a
+// worker pool, so clients are answered concurrently; each connection has
+// at most one request on the pool, so its responses come back in order.
+//
+// Usage: maxcalorie_server [--socket PATH] [--db PATH] [--snapshot PATH]
+//	[--threads N] [--cache-bytes BYTES] [--max-weight W]
+//	[--idle-timeout SECONDS] [--solve-timeout SECONDS]
+//
+// With --snapshot the database is read through a binary snapshot that is
+// rebuilt when the CSV changes (see foodtable.hh). Answers are kept in an
+// LRU cache of at most --cache-bytes (default 64MB; 0 turns it off).
+// Queries with a TOTAL_WEIGHT above --max-weight (default 1000000) are
+// refused, which bounds the memory one query can take. A connection that
+// sends nothing for --idle-timeout seconds (default 60) is closed. A solve
+// that runs for --solve-timeout seconds (default 10; 0 for no limit) stops
+// with the best answer it has, which is marked APPROXIMATE.
+//
+// The protocol is line-based; every request is one line, and lines may end
+// in "\n" or "\r\n":
+//
+//	SOLVE MIN_CALORIES MAX_CALORIES TOTAL_SIZE TOTAL_WEIGHT [ALGORITHM]
+//		OK COUNT WEIGHT CALORIES [APPROXIMATE]
+//		followed by COUNT lines DESCRIPTION^WEIGHT^CALORIES
+//	PING
+//		PONG
+//	STATS
+//		STATS HITS MISSES ENTRIES BYTES	(of the result cache)
+//	QUIT
+//		(closes the connection)
+//
+// A request that cannot be answered gets a single "ERROR message" line. A
+// line longer than MAX_LINE_BYTES gets an ERROR line and the connection is
+// closed.
+// SIGINT or SIGTERM stops the server and removes the socket file.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "foodtable.hh"
+#include "maxcalorie.hh"
+#include "maxcalorie_query.hh"
+#include "timer.hh"
+#include "worker_pool.hh"
+
+using namespace std;
+
+// Set by SIGINT and SIGTERM.
+volatile sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+  stop_requested = 1;
+}
+
+// How often blocked threads check stop_requested, in milliseconds.
+const int POLL_INTERVAL_MS = 200;
+
+// Longest request line accepted, without its line ending.
+const size_t MAX_LINE_BYTES = 4096;
+
+// Send all of text; false when the client has gone away.
+bool send_all(int fd, const string& text)
+{
+  for (size_t sent = 0; sent < text.size(); )
+  {
+    ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// The database being served.
+struct ServedDatabase
+{
+  const FoodCalorieIndex& index;
+
+  // Answers are cached only when cache_bytes is positive.
+  FoodQueryCache& cache;
+  bool cache_enabled;
+
+  FoodQueryLimits limits;
+
+  // Longest a solve may run, in seconds; 0 for no limit.
+  double solve_timeout;
+};
+
+// The response to one request line; empty to close the connection.
+string respond(ServedDatabase& db, const string& line)
+{
+  istringstream ss(line);
+  string command;
+  ss >> command;
+
+  if (command == "PING")
+  {
+    return "PONG\n";
+  }
+  if (command == "QUIT")
+  {
+    return "";
+  }
+  if (command == "STATS")
+  {
+    ostringstream out;
+    out << "STATS " << db.cache.hits() << " " << db.cache.misses() << " " << db.cache.size() << " " << db.cache.bytes() << "\n";
+    return out.str();
+  }
+  if (command != "SOLVE")
+  {
+    return "ERROR unknown command: " + command + "\n";
+  }
+
+  string rest, error;
+  getline(ss, rest);
+  FoodQuery query;
+  if (!parse_food_query(rest, query, error, db.limits))
+  {
+    return "ERROR " + error + "\n";
+  }
+  SolveControl control;
+  if (db.solve_timeout > 0)
+  {
+    control.set_timeout(db.solve_timeout);
+  }
+  shared_ptr<const FoodVector> solution;
+  bool proven = true;
+  try
+  {
+    if (db.cache_enabled)
+    {
+      solution = db.cache.answer(db.index, query, error, &control, &proven);
+    }
+    else
+    {
+      solution = answer_food_query(db.index, query, error, &control, &proven);
+    }
+  }
+  catch (const exception& e)
+  {
+    // Such as bad_alloc; the other connections carry on
+    return string("ERROR solve failed: ") + e.what() + "\n";
+  }
+  if (!solution)
+  {
+    return "ERROR " + error + "\n";
+  }
+
+  double weight, calories;
+  sum_food_vector(*solution, weight, calories);
+  ostringstream out;
+  out << setprecision(15) << "OK " << solution->size() << " " << weight << " " << calories << (proven ? "" : " APPROXIMATE") << "\n";
+  for (auto& food : *solution)
+  {
+    out << food->description() << "^" << food->weight() << "^" << food->foodCalories() << "\n";
+  }
+  return out.str();
+}
+
+// A client connection, owned by the polling thread.
+struct Connection
+{
+  // Received text not yet handed to the pool.
+  string buffer;
+
+  // Time since the client last sent anything or was last answered.
+  Timer idle;
+
+  // True while one of its requests is on the pool. The next one waits, so
+  // that responses go out in request order.
+  bool busy = false;
+};
+
+// Sent by a worker through the wake pipe once it has answered a request.
+struct Answered
+{
+  int fd;
+  bool keep_open;
+};
+
+// Hand connection's next complete request line, if any, to the pool; the
+// worker reports back on wake_fd. Returns false when the connection must
+// be closed because the line is too long.
+bool dispatch_request(ServedDatabase& db, WorkerPool& pool, int wake_fd, int fd, Connection& connection)
+{
+  if (connection.busy)
+  {
+    return true;
+  }
+  size_t end = connection.buffer.find('\n');
+  // A partial line may still be followed by "\r"
+  if (end == string::npos ? connection.buffer.size() > MAX_LINE_BYTES + 1 : end > MAX_LINE_BYTES + 1)
+  {
+    send_all(fd, "ERROR request line too long\n");
+    return false;
+  }
+  if (end == string::npos)
+  {
+    return true;
+  }
+
+  string line = connection.buffer.substr(0, end);
+  connection.buffer.erase(0, end + 1);
+  if (!line.empty() && line.back() == '\r')
+  {
+    line.pop_back();
+  }
+
+  connection.busy = true;
+  pool.submit([&db, wake_fd, fd, line]()
+  {
+    Answered answered = { fd, false };
+    try
+    {
+      string response = respond(db, line);
+      answered.keep_open = !response.empty() && send_all(fd, response);
+    }
+    catch (const exception&)
+    {
+      // Such as bad_alloc while formatting; drop the connection
+    }
+    // Writes this small to a pipe are atomic
+    while (write(wake_fd, &answered, sizeof(answered)) < 0 && errno == EINTR)
+    {
+    }
+  });
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  string socket_path = "maxcalorie.sock";
+  string db_path = "food.csv";
+  string snapshot_path;
+  unsigned threads = 0;
+  size_t cache_bytes = 64 * 1024 * 1024;
+  FoodQueryLimits limits;
+  double idle_timeout = 60;
+  double solve_timeout = 10;
+
+  for (int i = 1; i < argc; i += 2)
+  {
+    string flag = argv[i];
+    if (i + 1 >= argc)
+    {
+      cout << "Missing value for " << flag << endl;
+      return 2;
+    }
+    string value = argv[i + 1];
+
+    if (flag == "--socket") socket_path = value;
+    else if (flag == "--db") db_path = value;
+    else if (flag == "--snapshot") snapshot_path = value;
+    else if (flag == "--threads") threads = atoi(value.c_str());
+    else if (flag == "--cache-bytes") cache_bytes = strtoull(value.c_str(), nullptr, 10);
+    else if (flag == "--max-weight") limits.max_total_weight = atof(value.c_str());
+    else if (flag == "--idle-timeout") idle_timeout = atof(value.c_str());
+    else if (flag == "--solve-timeout") solve_timeout = atof(value.c_str());
+    else
+    {
+      cout << "Invalid option " << flag << endl;
+      return 2;
+    }
+  }
+
+  auto foods = snapshot_path.empty() ? load_food_database(db_path) : load_food_database_cached(db_path, snapshot_path);
+  if (!foods)
+  {
+    return 1;
+  }
+  const FoodCalorieIndex index(*foods);
+  FoodQueryCache cache(cache_bytes);
+  ServedDatabase db = { index, cache, cache_bytes > 0, limits, solve_timeout };
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+  {
+    cout << "Socket path too long: " << socket_path << endl;
+    return 1;
+  }
+  strcpy(address.sun_path, socket_path.c_str());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path.c_str());
+  if (listener < 0
+      || bind(listener, (sockaddr*)&address, sizeof(address)) != 0
+      || listen(listener, SOMAXCONN) != 0)
+  {
+    cout << "Cannot listen on " << socket_path << ": " << strerror(errno) << endl;
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = request_stop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  // Workers write an Answered record to wake[1] to wake the poll below
+  int wake[2];
+  if (pipe(wake) != 0 || fcntl(wake[0], F_SETFL, O_NONBLOCK) != 0)
+  {
+    cout << "Cannot create pipe: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  map<int, Connection> connections;
+  {
+    WorkerPool pool(threads);
+    cout << "Serving " << foods->size() << " foods on " << socket_path
+         << " with " << pool.size() << " threads" << endl;
+
+    char chunk[4096];
+    while (!stop_requested)
+    {
+      // Connections with a request on the pool are not read meanwhile
+      vector<pollfd> polled = { { listener, POLLIN, 0 }, { wake[0], POLLIN, 0 } };
+      for (auto& entry : connections)
+      {
+        if (!entry.second.busy)
+        {
+          polled.push_back({ entry.first, POLLIN, 0 });
+        }
+      }
+      if (poll(polled.data(), polled.size(), POLL_INTERVAL_MS) < 0)
+      {
+        continue;
+      }
+
+      set<int> closing;
+      if (polled[0].revents & POLLIN)
+      {
+        int client = accept(listener, nullptr, nullptr);
+        if (client >= 0)
+        {
+          connections[client];
+        }
+      }
+      Answered answered;
+      while (read(wake[0], &answered, sizeof(answered)) == sizeof(answered))
+      {
+        Connection& connection = connections[answered.fd];
+        connection.busy = false;
+        connection.idle.reset();
+        if (!answered.keep_open || !dispatch_request(db, pool, wake[1], answered.fd, connection))
+        {
+          closing.insert(answered.fd);
+        }
+      }
+      for (size_t i = 2; i < polled.size(); i++)
+      {
+        if (polled[i].revents == 0)
+        {
+          continue;
+        }
+        int fd = polled[i].fd;
+        Connection& connection = connections[fd];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+        {
+          closing.insert(fd);
+          continue;
+        }
+        connection.idle.reset();
+        connection.buffer.append(chunk, n);
+        if (!dispatch_request(db, pool, wake[1], fd, connection))
+        {
+          closing.insert(fd);
+        }
+      }
+
+      for (auto& entry : connections)
+      {
+        if (!entry.second.busy && entry.second.idle.elapsed() >= idle_timeout)
+        {
+          closing.insert(entry.first);
+        }
+      }
+      for (int fd : closing)
+      {
+        close(fd);
+        connections.erase(fd);
+      }
+    }
+  }
+
+  // The pool has finished every request, so no worker uses these now
+  for (auto& entry : connections)
+  {
+    close(entry.first);
+  }
+  close(wake[0]);
+  close(wake[1]);
+  close(listener);
+  unlink(socket_path.c_str());
+  cout << "Stopped" << endl;
+  return 0;
+}
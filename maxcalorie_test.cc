@@ -7,14 +7,37 @@
 
 
 #include <cassert>
+#include <cstdlib>
 #include <sstream>
+#include <string>
 
 
+#include "benchmark.hh"
+#include "food_generator.hh"
+#include "foodtable.hh"
 #include "maxcalorie.hh"
+#include "maxcalorie_query.hh"
 #include "rubrictest.hh"
+#include "worker_pool.hh"
 
-int main()
+// Usage: maxcalorie_test [--jobs N] [--timeout SECONDS] [--timing]
+int main(int argc, char* argv[])
 {
+	RubricOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string flag = argv[i];
+		if (flag == "--timing")
+			options.timing = true;
+		else if (flag == "--jobs" && i + 1 < argc)
+			options.threads = std::atoi(argv[++i]);
+		else if (flag == "--timeout" && i + 1 < argc)
+			options.timeout_seconds = std::atof(argv[++i]);
+		else {
+			std::cout << "Usage: maxcalorie_test [--jobs N] [--timeout SECONDS] [--timing]" << std::endl;
+			return 1;
+		}
+	}
+	
 	Rubric rubric;
 	
 	FoodVector trivial_foods;
@@ -59,6 +82,231 @@ int main()
 		}
 	);
 	
+	//
+	rubric.criterion(
+		"interned descriptions", 1,
+		[&]()
+		{
+			const FoodItem& first = *(*all_foods)[0];
+			size_t repeats = 0;
+			for (auto& food : *all_foods) {
+				TEST_TRUE("interned", food->description_id() != 0);
+				TEST_EQUAL("same text, same id", food->description() == first.description(), food->description_id() == first.description_id());
+				if (food->same_description(first)) {
+					TEST_EQUAL("shared storage", first.description().data(), food->description().data());
+					repeats++;
+				}
+			}
+			TEST_GT("repeated description", repeats, 1);
+			TEST_TRUE("standalone item", trivial_foods[0]->same_description(FoodItem("test whole corn", 1, 1)));
+			TEST_FALSE("standalone item", trivial_foods[0]->same_description(*trivial_foods[1]));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"filter_food_view", 2,
+		[&]()
+		{
+			for (int total_size : {1, 3, 10, 100, 9000}) {
+				auto expected = filter_food_vector(*all_foods, 100, 500, total_size);
+				auto view = filter_food_view(*all_foods, 100, 500, total_size);
+				TEST_TRUE("non-null", view);
+				TEST_EQUAL("size", expected->size(), view->size());
+				for (size_t i = 0; i < expected->size(); i++) {
+					TEST_EQUAL("contents", (*expected)[i], (*view)[i]);
+				}
+				
+				// Filtering a view again
+				auto nested = filter_food_view(*view, 200, 400, 5);
+				auto nested_expected = filter_food_vector(*expected, 200, 400, 5);
+				TEST_EQUAL("nested size", nested_expected->size(), nested->size());
+				for (size_t i = 0; i < nested->size(); i++) {
+					TEST_EQUAL("nested contents", (*nested_expected)[i], (*nested)[i]);
+				}
+			}
+			
+			auto prefix = filter_food_view(*filtered_foods, 1, 2500, 20);
+			TEST_TRUE("prefix of an already filtered vector", prefix->is_prefix());
+			TEST_TRUE("prefix of a view", filter_food_view(*prefix, 1, 2500, 10)->is_prefix());
+			TEST_FALSE("not a prefix", filter_food_view(*all_foods, 100, 500, 10)->is_prefix());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"FoodCalorieIndex matches filter_food_vector", 2,
+		[&]()
+		{
+			FoodCalorieIndex index(*all_foods);
+			std::vector<double> bounds = { -1, 0, 1, 100, 250.5, 500, 1000, 2000, 2500, 5000 };
+			for (double min_calories : bounds) {
+				for (double max_calories : bounds) {
+					for (int total_size : {1, 3, 20, 200, 9000}) {
+						auto expected = filter_food_vector(*all_foods, min_calories, max_calories, total_size);
+						auto actual = index.filter(min_calories, max_calories, total_size);
+						auto view = index.filter_view(min_calories, max_calories, total_size);
+						TEST_TRUE("non-null", actual);
+						TEST_TRUE("non-null", view);
+						TEST_EQUAL("size", expected->size(), actual->size());
+						TEST_EQUAL("size", expected->size(), view->size());
+						bool leads = true;
+						for (size_t i = 0; i < expected->size(); i++)
+							leads = leads && (*expected)[i] == (*all_foods)[i];
+						TEST_EQUAL("prefix exactly when the matches lead the source", leads, view->is_prefix());
+						for (size_t i = 0; i < expected->size(); i++) {
+							TEST_EQUAL("contents", (*expected)[i], (*actual)[i]);
+							TEST_EQUAL("contents", (*expected)[i], (*view)[i]);
+						}
+					}
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"load_filtered_food_database", 2,
+		[&]()
+		{
+			for (int total_size : {1, 10, 500, 100000}) {
+				auto streamed = load_filtered_food_database("food.csv", 100, 500, total_size);
+				auto filtered = filter_food_vector(*all_foods, 100, 500, total_size);
+				TEST_TRUE("non-null", streamed);
+				TEST_EQUAL("size", filtered->size(), streamed->size());
+				for (size_t i = 0; i < filtered->size(); i++) {
+					TEST_EQUAL("contents", (*filtered)[i]->description(), (*streamed)[i]->description());
+					TEST_EQUAL("contents", (*filtered)[i]->foodCalories(), (*streamed)[i]->foodCalories());
+				}
+			}
+			
+			long visited = 0;
+			TEST_EQUAL("early stop", 3, stream_food_database("food.csv", 1, 2500, 3,
+				[&](const std::shared_ptr<FoodItem>&) { visited++; }));
+			TEST_EQUAL("early stop", 3, visited);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"solver scratch memory", 1,
+		[&]()
+		{
+			SolverScratch scratch;
+			auto small_foods = filter_food_vector(*filtered_foods, 1, 2000, 50);
+			
+			auto first = dynamic_max_calories(*small_foods, 2000, scratch);
+			auto second = dynamic_max_calories(*small_foods, 2000, scratch);
+			size_t capacity = scratch.capacity();
+			auto third = dynamic_max_calories(*small_foods, 2000, scratch);
+			
+			TEST_EQUAL("same answer", first->size(), third->size());
+			TEST_GE("table retained", capacity, 51 * 2001 * sizeof(double));
+			TEST_EQUAL("buffer reused", capacity, scratch.capacity());
+			
+			// A table over the cap is not kept whole
+			auto large_foods = filter_food_vector(*filtered_foods, 1, 2000, 500);
+			dynamic_max_calories(*large_foods, 5000, scratch);
+			dynamic_max_calories(*large_foods, 5000, scratch);
+			TEST_EQUAL("capped", SolverScratch::MAX_RETAINED_BYTES, scratch.capacity());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"food snapshot round trip", 2,
+		[&]()
+		{
+			const std::string snapshot_path = "maxcalorie_test.snapshot";
+			std::remove(snapshot_path.c_str());
+			
+			auto written = load_food_table("food.csv", snapshot_path);
+			auto mapped = map_food_snapshot(snapshot_path, "food.csv");
+			auto cached = load_food_database_cached("food.csv", snapshot_path);
+			std::remove(snapshot_path.c_str());
+			
+			TEST_TRUE("non-null", written);
+			TEST_TRUE("non-null", mapped);
+			TEST_TRUE("non-null", cached);
+			TEST_EQUAL("size", all_foods->size(), mapped->size());
+			TEST_EQUAL("size", all_foods->size(), cached->size());
+			for (size_t i = 0; i < all_foods->size(); i++) {
+				TEST_EQUAL("description", (*all_foods)[i]->description(), mapped->description(i));
+				TEST_EQUAL("weight", (*all_foods)[i]->weight(), mapped->weight(i));
+				TEST_EQUAL("calories", (*all_foods)[i]->foodCalories(), (*cached)[i]->foodCalories());
+			}
+			
+			TEST_FALSE("missing snapshot", map_food_snapshot(snapshot_path, "food.csv"));
+			
+			uint64_t source_size;
+			int64_t source_mtime_ns;
+			TEST_TRUE("stamp", food_source_stamp("food.csv", source_size, source_mtime_ns));
+			TEST_FALSE("source changed since the stamp", write_food_snapshot(*written, snapshot_path, "food.csv", source_size + 1, source_mtime_ns));
+			TEST_FALSE("nothing written", map_food_snapshot(snapshot_path, "food.csv"));
+			
+			// Corrupt sizes and offsets are refused even with a valid checksum
+			std::vector<char> image(written->data(), written->data() + written->size_in_bytes());
+			FoodSnapshotHeader header;
+			std::memcpy(&header, image.data(), sizeof(header));
+			FoodTable attached;
+			TEST_TRUE("intact image", attached.attach(nullptr, image.data(), image.size()));
+			auto corrupted = [&](FoodSnapshotHeader changed, size_t offset_index, uint64_t offset) {
+				std::vector<char> copy = image;
+				std::memcpy(copy.data() + sizeof(header) + 2 * header.count * sizeof(double) + offset_index * sizeof(uint64_t), &offset, sizeof(offset));
+				changed.checksum = fnv1a_64(copy.data() + sizeof(header), copy.size() - sizeof(header));
+				std::memcpy(copy.data(), &changed, sizeof(changed));
+				FoodTable table;
+				return !table.attach(nullptr, copy.data(), copy.size());
+			};
+			FoodSnapshotHeader huge_blob = header;
+			huge_blob.blob_size = ~uint64_t(0) - 100;
+			TEST_TRUE("wrapping blob size", corrupted(huge_blob, 0, 0));
+			FoodSnapshotHeader huge_count = header;
+			huge_count.count = ~uint64_t(0) / 8;
+			TEST_TRUE("wrapping count", corrupted(huge_count, 0, 0));
+			TEST_TRUE("offset past the blob", corrupted(header, header.count, header.blob_size + 1));
+			TEST_TRUE("decreasing offsets", corrupted(header, 1, header.blob_size));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"filter_food_table", 2,
+		[&]()
+		{
+			FoodTable table = FoodTable::from_food_vector(*all_foods);
+			std::vector<double> bounds = { -1, 1, 60, 100, 500, 2500 };
+			for (double min_calories : bounds) {
+				for (double max_calories : bounds) {
+					for (size_t total_size : {0, 1, 7, 100, 9000}) {
+						FoodPredicate predicate;
+						predicate.min_calories = min_calories;
+						predicate.max_calories = max_calories;
+						predicate.max_weight = 80;
+						
+						auto expected = filter_food_table_scalar(table, predicate, total_size);
+						TEST_TRUE("dispatch", expected == filter_food_table(table, predicate, total_size));
+#ifdef FOODTABLE_HAVE_AVX2
+						if (__builtin_cpu_supports("avx2")) {
+							TEST_TRUE("avx2", expected == filter_food_table_avx2(table, predicate, total_size));
+						}
+#endif
+						
+						predicate.max_weight = HUGE_VAL;
+						auto calories_only = filter_food_table(table, predicate, total_size);
+						if (total_size > 0) {
+							auto vector = filter_food_vector(*all_foods, min_calories, max_calories, total_size);
+							TEST_EQUAL("size", vector->size(), calories_only.size());
+							for (size_t i = 0; i < vector->size(); i++) {
+								TEST_EQUAL("contents", (*vector)[i], (*all_foods)[calories_only[i]]);
+							}
+						}
+					}
+				}
+			}
+		}
+	);
+	
 	//
 	
     	//
@@ -174,7 +422,7 @@ int main()
 				int n = optimal_index + 1;
 				double expected_calories = optimal_calories_totals[optimal_index];
 				
-				auto small_foods = filter_food_vector(*filtered_foods, 1, 2000, n);
+				auto small_foods = filter_food_view(*filtered_foods, 1, 2000, n);
 				TEST_TRUE("non-null", small_foods);
 				
 				auto solution = exhaustive_max_calories(*small_foods, 2000);
@@ -197,14 +445,505 @@ int main()
 				
 				auto dynamic_solution = dynamic_max_calories(*small_foods, 2000);
 				double dynamic_actual_weight, dynamic_actual_calories;
-				sum_food_vector(*solution, dynamic_actual_weight, dynamic_actual_calories);
+				sum_food_vector(*dynamic_solution, dynamic_actual_weight, dynamic_actual_calories);
 				dynamic_actual_calories	= std::round( dynamic_actual_calories	/ 100.0) * 100;
 				TEST_EQUAL("Exhaustive and dynamic programming get the same answer", actual_calories, dynamic_actual_calories);
 			}
 		}
 	);
 
-	return rubric.run();
+	//
+	rubric.criterion(
+		"prefix sweeps match per-prefix solves", 2,
+		[&]()
+		{
+			auto foods = filter_food_view(*filtered_foods, 1, 2000, 200);
+			
+			std::vector<SweepPoint> dynamic_points;
+			std::vector<double> solved_in_visit;
+			dynamic_max_calories_sweep(*foods, 2000, [&](const SweepPoint& point) {
+				dynamic_points.push_back(point);
+				// Solving on the sweep's thread must not disturb the sweep
+				if (point.n % 50 == 0) {
+					double weight, calories;
+					sum_food_vector(*dynamic_max_calories(foods->prefix(point.n), 2000), weight, calories);
+					solved_in_visit.push_back(calories);
+				}
+			});
+			for (size_t k = 0; k < solved_in_visit.size(); k++)
+				TEST_TRUE("solve inside visit", std::abs(solved_in_visit[k] - dynamic_points[50 * (k + 1) - 1].calories) < 1e-6);
+			TEST_EQUAL("every prefix", foods->size(), dynamic_points.size());
+			for (size_t n = 1; n <= foods->size(); n += 13) {
+				auto solution = dynamic_max_calories(foods->prefix(n), 2000);
+				double weight, calories;
+				sum_food_vector(*solution, weight, calories);
+				TEST_EQUAL("prefix length", n, dynamic_points[n - 1].n);
+				TEST_TRUE("dynamic optimum", std::abs(calories - dynamic_points[n - 1].calories) < 1e-6);
+			}
+			
+			std::vector<SweepPoint> exhaustive_points;
+			exhaustive_max_calories_sweep(foods->prefix(16), 2000, [&](const SweepPoint& point) {
+				exhaustive_points.push_back(point);
+				exhaustive_max_calories(foods->prefix(point.n), 2000);
+			});
+			TEST_EQUAL("every prefix", 16, exhaustive_points.size());
+			for (size_t n = 1; n <= 16; n++) {
+				auto solution = exhaustive_max_calories(foods->prefix(n), 2000);
+				double weight, calories;
+				sum_food_vector(*solution, weight, calories);
+				TEST_EQUAL("exhaustive optimum", calories, exhaustive_points[n - 1].calories);
+				TEST_LE("elapsed", exhaustive_points[n - 1].step_seconds, exhaustive_points[n - 1].elapsed_seconds);
+			}
+			
+			size_t visited = 0;
+			exhaustive_max_calories_sweep(foods->prefix(EXHAUSTIVE_SWEEP_MAX_SIZE + 1), 2000, [&](const SweepPoint&) { visited++; });
+			TEST_EQUAL("too many foods refused", 0, visited);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"benchmark statistics", 1,
+		[&]()
+		{
+			BenchmarkResult result;
+			result.samples = { 5, 1, 4, 2, 3, 100 };
+			summarize_benchmark(result, 1.5);
+			TEST_TRUE("outlier rejected", result.outlier[5]);
+			TEST_EQUAL("kept", 5, result.kept);
+			TEST_EQUAL("median", 3, result.median);
+			TEST_EQUAL("mean", 3, result.mean);
+			TEST_EQUAL("min", 1, result.min);
+			TEST_EQUAL("max", 5, result.max);
+			TEST_TRUE("p95", std::abs(result.p95 - 4.8) < 1e-9);
+			TEST_TRUE("stddev", std::abs(result.stddev - std::sqrt(2.5)) < 1e-9);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"complexity fitting", 1,
+		[&]()
+		{
+			std::vector<TimingPoint> timings;
+			for (int n = 1; n <= 20; n++) {
+				timings.push_back(TimingPoint{ "exhaustive", n, 2000, 3e-9 * n * std::ldexp(1.0, n) });
+				timings.push_back(TimingPoint{ "dynamic", n, 500.0 * n, 2e-9 * n * (500.0 * n + 1) });
+			}
+			
+			ComplexityFit exhaustive = fit_complexity("exhaustive", timings);
+			ComplexityFit dynamic = fit_complexity("dynamic", timings);
+			TEST_EQUAL("points", 20, exhaustive.points);
+			TEST_TRUE("exhaustive constant", std::abs(exhaustive.constant / 3e-9 - 1) < 1e-9);
+			TEST_TRUE("dynamic constant", std::abs(dynamic.constant / 2e-9 - 1) < 1e-9);
+			TEST_TRUE("exact fit", std::abs(exhaustive.r_squared - 1) < 1e-9);
+			TEST_EQUAL("unknown model", 0, fit_complexity("greedy", timings).points);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"synthetic food generator", 1,
+		[&]()
+		{
+			FoodGeneratorOptions options;
+			options.seed = 42;
+			options.n = 500;
+			options.correlation = FoodCorrelation::STRONGLY_CORRELATED;
+			options.duplicate_rate = 0.2;
+			
+			std::stringstream first, second;
+			write_generated_food_csv(options, first);
+			write_generated_food_csv(options, second);
+			TEST_TRUE("deterministic", first.str() == second.str());
+			
+			auto foods = generate_food_vector(options);
+			TEST_EQUAL("size", 500, foods->size());
+			for (auto& food : *foods) {
+				TEST_TRUE("weight range", food->weight() >= options.min_weight && food->weight() <= options.max_weight);
+				TEST_EQUAL("strong correlation", food->weight() + options.max_weight / 10, food->foodCalories());
+			}
+			
+			options.seed = 43;
+			std::stringstream other;
+			write_generated_food_csv(options, other);
+			TEST_FALSE("seeded", first.str() == other.str());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"registered solvers agree with exhaustive search", 1,
+		[&]()
+		{
+			TEST_TRUE("exhaustive registered", find_food_solver("exhaustive"));
+			TEST_TRUE("dynamic registered", find_food_solver("dynamic"));
+			TEST_FALSE("unknown solver", find_food_solver("greedy"));
+			
+			for (uint64_t seed = 1; seed <= 20; seed++) {
+				FoodGeneratorOptions options;
+				options.seed = seed;
+				options.n = 12;
+				options.correlation = FoodCorrelation(seed % 4);
+				auto foods = generate_food_vector(options);
+				const double total_weight = 25.0 * (seed % 10);
+				
+				double expected_weight, expected_calories;
+				sum_food_vector(*exhaustive_max_calories(*foods, total_weight), expected_weight, expected_calories);
+				for (auto& solver : food_solver_registry()) {
+					double weight, calories;
+					sum_food_vector(*solver.solve(*foods, total_weight), weight, calories);
+					TEST_LE(solver.name + " feasible", weight, total_weight);
+					TEST_EQUAL(solver.name + " optimal", expected_calories, calories);
+				}
+			}
+			
+			// Solvers that need whole weights refuse the rest, without an answer
+			FoodVector fractional{ std::make_shared<FoodItem>("half", 1.5, 10), std::make_shared<FoodItem>("one", 1, 5) };
+			const FoodSolver& dynamic = *find_food_solver("dynamic");
+			std::string error;
+			TEST_FALSE("fractional food refused", food_solver_accepts_foods(dynamic, fractional, error));
+			TEST_FALSE("fractional food unanswered", dynamic.solve(fractional, 2));
+			TEST_FALSE("fractional weight unanswered", dynamic.solve(FoodVector(), 2.5));
+			TEST_TRUE("branch_and_bound takes fractions", food_solver_accepts_foods(*find_food_solver("branch_and_bound"), fractional, error));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"dynamic is 10x faster than exhaustive at n = 20", 1,
+		[&]()
+		{
+			auto foods = filter_food_view(*filtered_foods, 1, 2000, 20);
+			TEST_EQUAL("size", 20, foods->size());
+			TEST_FASTER_THAN("dynamic vs exhaustive", 10,
+				dynamic_max_calories(*foods, 2000),
+				exhaustive_max_calories(*foods, 2000));
+			TEST_WITHIN_BUDGET("dynamic budget", 0.5, dynamic_max_calories(*foods, 2000));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"queries answered on a worker pool", 1,
+		[&]()
+		{
+			FoodQuery query;
+			std::string error;
+			TEST_TRUE("parse", parse_food_query("1 2000 20 2000 exhaustive", query, error));
+			TEST_EQUAL("total size", 20, query.total_size);
+			TEST_EQUAL("algorithm", "exhaustive", query.algorithm);
+			TEST_TRUE("default algorithm", parse_food_query("1 2000 20 2000", query, error) && query.algorithm == "dynamic");
+			TEST_FALSE("missing fields", parse_food_query("1 2000", query, error));
+			TEST_FALSE("bad size", parse_food_query("1 2000 0 2000", query, error));
+			TEST_FALSE("negative weight", parse_food_query("1 2000 20 -1", query, error));
+			TEST_FALSE("huge weight", parse_food_query("1 2000 20 1e12", query, error));
+			TEST_FALSE("weight above limit", parse_food_query("1 2000 20 3000", query, error, FoodQueryLimits{ 2500 }));
+			
+			FoodCalorieIndex index(*all_foods);
+			query.algorithm = "nope";
+			TEST_FALSE("unknown algorithm", answer_food_query(index, query, error));
+			query.algorithm = "dynamic";
+			query.total_weight = 2000.5;
+			TEST_FALSE("fractional weight for dynamic", answer_food_query(index, query, error));
+			query.total_weight = 3e9;
+			TEST_FALSE("weight above INT_MAX", answer_food_query(index, query, error));
+			query.algorithm = "branch_and_bound";
+			query.total_weight = 2000.5;
+			TEST_TRUE("fractional weight for branch and bound", answer_food_query(index, query, error));
+			
+			WorkerPool pool(3);
+			std::vector<std::future<double>> answers;
+			for (int total_size = 1; total_size <= 20; total_size++) {
+				answers.push_back(pool.async([&index, total_size]() {
+					FoodQuery query;
+					query.min_calories = 1;
+					query.max_calories = 2000;
+					query.total_size = total_size;
+					query.total_weight = 2000;
+					std::string error;
+					double weight, calories;
+					sum_food_vector(*answer_food_query(index, query, error), weight, calories);
+					return calories;
+				}));
+			}
+			for (int total_size = 1; total_size <= 20; total_size++) {
+				auto foods = filter_food_view(*all_foods, 1, 2000, total_size);
+				double weight, calories;
+				sum_food_vector(*dynamic_max_calories(*foods, 2000), weight, calories);
+				TEST_EQUAL("same answer", calories, answers[total_size - 1].get());
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"query result cache", 1,
+		[&]()
+		{
+			FoodCalorieIndex index(*all_foods);
+			FoodQuery query;
+			std::string error;
+			TEST_TRUE("parse", parse_food_query("1 2000 20 2000", query, error));
+			
+			FoodQueryCache cache;
+			auto first = cache.answer(index, query, error);
+			auto second = cache.answer(index, query, error);
+			TEST_TRUE("non-null", first);
+			TEST_TRUE("cached answer", first == second);
+			TEST_EQUAL("hits", 1, cache.hits());
+			TEST_EQUAL("misses", 1, cache.misses());
+			
+			query.algorithm = "nope";
+			TEST_FALSE("failure", cache.answer(index, query, error));
+			TEST_EQUAL("failures not cached", 1, cache.size());
+			query.algorithm = "dynamic";
+			
+			FoodCalorieIndex rebuilt(*all_foods);
+			TEST_GT("new index, new generation", rebuilt.generation(), index.generation());
+			auto reloaded = cache.answer(rebuilt, query, error);
+			TEST_FALSE("new generation misses", reloaded == first);
+			TEST_EQUAL("old generation dropped", 1, cache.size());
+			
+			FoodQueryCache small(cache.bytes() * 2);
+			for (int total_size = 1; total_size <= 10; total_size++) {
+				query.total_size = total_size;
+				small.answer(rebuilt, query, error);
+				TEST_LE("bounded", small.bytes(), small.max_bytes());
+			}
+			TEST_LT("evicted", small.size(), 10);
+			small.answer(rebuilt, query, error);
+			TEST_EQUAL("most recent kept", 1, small.hits());
+			
+			// Answers cut short by their control are not cached
+			SolveControl expired;
+			expired.set_deadline(SolveControl::Clock::now() - std::chrono::seconds(1));
+			TEST_TRUE("parse", parse_food_query("1 2000 30 2000 exhaustive", query, error));
+			bool proven = true;
+			TEST_TRUE("approximate answer", small.answer(rebuilt, query, error, &expired, &proven));
+			TEST_FALSE("not proven", proven);
+			size_t entries = small.size();
+			small.answer(rebuilt, query, error, &expired, &proven);
+			TEST_EQUAL("approximate answers not cached", entries, small.size());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"smaller capacities answered from a cached table", 1,
+		[&]()
+		{
+			auto foods = filter_food_view(*filtered_foods, 1, 2000, 50);
+			DynamicTableCache cache(2);
+			
+			for (int W = 3000; W >= 0; W -= 250) {
+				auto reused = dynamic_max_calories_reusing(*foods, W, cache);
+				auto rebuilt = dynamic_max_calories(*foods, W);
+				TEST_TRUE("same foods", *reused == *rebuilt);
+			}
+			TEST_EQUAL("built once", 1, cache.misses());
+			TEST_EQUAL("reused", 12, cache.hits());
+			
+			dynamic_max_calories_reusing(*foods, 4000, cache);
+			TEST_EQUAL("larger capacity rebuilds", 2, cache.misses());
+			TEST_EQUAL("replaces the smaller table", 1, cache.size());
+			
+			auto other = filter_food_view(*filtered_foods, 1, 2000, 49);
+			dynamic_max_calories_reusing(*other, 100, cache);
+			dynamic_max_calories_reusing(foods->prefix(10), 100, cache);
+			TEST_EQUAL("different foods rebuild", 4, cache.misses());
+			TEST_EQUAL("bounded", 2, cache.size());
+			
+			DynamicKnapsackTable table(*foods, 2000);
+			double weight, calories;
+			sum_food_vector(*table.solve(1500), weight, calories);
+			TEST_TRUE("best calories", std::abs(calories - table.best_calories(1500)) < 1e-6);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"query groups match single queries", 1,
+		[&]()
+		{
+			FoodCalorieIndex index(*all_foods);
+			std::vector<FoodQuery> queries;
+			for (double total_weight : { 2000.0, 500.0, 3500.0, 0.0, 1234.0 }) {
+				FoodQuery query;
+				std::string error;
+				std::ostringstream text;
+				text << "1 2500 60 " << total_weight;
+				TEST_TRUE("parse", parse_food_query(text.str(), query, error));
+				TEST_TRUE("same group", queries.empty() || same_food_query_group(queries[0], query));
+				queries.push_back(query);
+			}
+			
+			std::vector<std::unique_ptr<FoodVector>> answers;
+			std::vector<std::string> errors;
+			answer_food_query_group(index, queries, answers, errors);
+			TEST_EQUAL("one answer per query", queries.size(), answers.size());
+			for (size_t i = 0; i < queries.size(); i++) {
+				std::string error;
+				auto single = answer_food_query(index, queries[i], error);
+				TEST_TRUE("answered", answers[i] && single);
+				TEST_TRUE("same foods", *answers[i] == *single);
+			}
+			
+			TEST_TRUE("dynamic shares one table", bool(find_food_solver("dynamic")->solve_capacities));
+			auto per_query = queries;
+			for (auto& query : per_query)
+				query.algorithm = "branch_and_bound";
+			std::vector<std::unique_ptr<FoodVector>> solved;
+			answer_food_query_group(index, per_query, solved, errors);
+			for (size_t i = 0; i < queries.size(); i++) {
+				double weight, calories, expected_weight, expected_calories;
+				sum_food_vector(*solved[i], weight, calories);
+				sum_food_vector(*answers[i], expected_weight, expected_calories);
+				TEST_TRUE("solved one by one", std::abs(calories - expected_calories) < 1e-6);
+			}
+			
+			queries[1].total_weight = 500.5;
+			answer_food_query_group(index, queries, answers, errors);
+			TEST_FALSE("fractional weight fails alone", answers[1]);
+			TEST_TRUE("others answered", answers[0] && answers[2] && errors[0].empty());
+			
+			for (auto& query : queries)
+				query.algorithm = "nope";
+			answer_food_query_group(index, queries, answers, errors);
+			TEST_FALSE("unknown algorithm", answers[0]);
+			TEST_EQUAL("error for every query", "unknown algorithm: nope", errors.back());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"asynchronous solves can be cancelled or time out", 1,
+		[&]()
+		{
+			auto small = filter_food_view(*filtered_foods, 1, 2000, 12);
+			SolveHandle quick = solve_async("exhaustive", *small, 2000);
+			SolveResult finished = quick.get();
+			TEST_TRUE("proven", finished.proven_optimal);
+			TEST_TRUE("same answer", *finished.foods == *exhaustive_max_calories(*small, 2000));
+			
+			// The solve keeps its own copy of a temporary vector
+			SolveHandle from_temporary = solve_async("exhaustive", *filter_food_vector(*filtered_foods, 1, 2000, 12), 2000);
+			TEST_TRUE("temporary input", *from_temporary.get().foods == *finished.foods);
+			
+			auto large = filter_food_view(*filtered_foods, 1, 2000, 30);
+			SolveHandle slow = solve_async("exhaustive", *large, 2000);
+			TEST_FALSE("still running", slow.wait_for(0.05));
+			slow.cancel();
+			TEST_TRUE("stops promptly", slow.wait_for(5));
+			SolveResult stopped = slow.get();
+			double weight, calories;
+			sum_food_vector(*stopped.foods, weight, calories);
+			TEST_FALSE("not proven", stopped.proven_optimal);
+			TEST_LE("feasible", weight, 2000);
+			TEST_GT("approximate answer", calories, 0);
+			
+			// 2^30 subsets take far longer than the timeout
+			SolveHandle timed = solve_async("exhaustive", *large, 2000, 0.05);
+			TEST_TRUE("stops at the deadline", timed.wait_for(5));
+			TEST_FALSE("not cancelled", timed.control().cancelled());
+			TEST_TRUE("deadline passed", timed.control().should_stop());
+			SolveResult timed_out = timed.get();
+			TEST_FALSE("deadline", timed_out.proven_optimal);
+			sum_food_vector(*timed_out.foods, weight, calories);
+			TEST_LE("feasible", weight, 2000);
+			
+			// A deadline already past stops the table at its first check
+			auto many = filter_food_view(*all_foods, 1, 2500, 1000);
+			SolveControl expired;
+			expired.set_deadline(SolveControl::Clock::now() - std::chrono::seconds(1));
+			SolveResult expired_result = dynamic_max_calories(*many, 20000, expired);
+			TEST_FALSE("past deadline", expired_result.proven_optimal);
+			sum_food_vector(*expired_result.foods, weight, calories);
+			TEST_LE("feasible", weight, 20000);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"branch and bound streams improving solutions", 1,
+		[&]()
+		{
+			auto foods = filter_food_view(*filtered_foods, 1, 2000, 200);
+			std::vector<Incumbent> incumbents;
+			bool proven = false;
+			auto best = branch_and_bound_max_calories(*foods, 2000,
+				[&](const Incumbent& incumbent) { incumbents.push_back(incumbent); },
+				nullptr, &proven);
+			TEST_TRUE("proven", proven);
+			TEST_FALSE("incumbents", incumbents.empty());
+			for (size_t i = 1; i < incumbents.size(); i++) {
+				TEST_GT("improving", incumbents[i].calories, incumbents[i - 1].calories);
+				TEST_GE("elapsed", incumbents[i].elapsed_seconds, incumbents[i - 1].elapsed_seconds);
+			}
+			
+			const Incumbent& last = incumbents.back();
+			TEST_EQUAL("last incumbent returned", last.indices.size(), best->size());
+			double weight = 0;
+			for (size_t i = 0; i < last.indices.size(); i++) {
+				TEST_TRUE("indices", (*foods)[last.indices[i]] == (*best)[i]);
+				weight += (*foods)[last.indices[i]]->weight();
+			}
+			TEST_TRUE("weight", std::abs(weight - last.weight) < 1e-6);
+			
+			double best_weight, best_calories, dynamic_weight, dynamic_calories;
+			sum_food_vector(*best, best_weight, best_calories);
+			sum_food_vector(*dynamic_max_calories(*foods, 2000), dynamic_weight, dynamic_calories);
+			TEST_TRUE("optimal", std::abs(best_calories - dynamic_calories) < 1e-6);
+			
+			SolveControl cancelled;
+			cancelled.cancel();
+			FoodGeneratorOptions options;
+			options.n = 60;
+			options.max_weight = 100000;
+			options.correlation = FoodCorrelation::SUBSET_SUM;
+			auto hard = generate_food_vector(options);
+			SolveResult stopped = branch_and_bound_max_calories(*hard, 1234567, cancelled);
+			TEST_FALSE("stopped", stopped.proven_optimal);
+			TEST_TRUE("greedy incumbent", stopped.foods && !stopped.foods->empty());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"solve progress reports", 1,
+		[&]()
+		{
+			auto foods = filter_food_view(*filtered_foods, 1, 2000, 16);
+			std::vector<SolveProgress> reports;
+			SolveControl control;
+			control.set_progress([&](const SolveProgress& progress) { reports.push_back(progress); }, 0);
+			
+			bool proven;
+			exhaustive_max_calories(*foods, 2000, default_solver_scratch(), &control, &proven);
+			TEST_EQUAL("every block and the end", 16, reports.size());
+			for (size_t i = 1; i < reports.size(); i++) {
+				TEST_GT("advancing", reports[i].fraction, reports[i - 1].fraction);
+				TEST_EQUAL("unit", std::string("subsets"), reports[i].unit);
+			}
+			TEST_EQUAL("done", 1, reports.back().fraction);
+			TEST_EQUAL("total", 65536, reports.back().total);
+			TEST_EQUAL("no time left", 0, reports.back().eta_seconds);
+			
+			reports.clear();
+			dynamic_max_calories(*foods, 2000, default_solver_scratch(), &control, &proven);
+			TEST_EQUAL("every row and the end", 17, reports.size());
+			TEST_EQUAL("unit", std::string("cells"), reports.back().unit);
+			TEST_EQUAL("cells", 17 * 2001, reports.back().done);
+			
+			SolveControl quiet;
+			quiet.set_progress([&](const SolveProgress& progress) { reports.push_back(progress); }, 3600);
+			reports.clear();
+			dynamic_max_calories(*foods, 2000, default_solver_scratch(), &quiet, &proven);
+			TEST_EQUAL("only the end within the interval", 1, reports.size());
+		}
+	);
+	
+	return rubric.run(options);
 }
 
 
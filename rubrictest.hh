@@ -7,10 +7,20 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
 #include <string>
+#include <thread>
 #include <vector>
 
 
@@ -82,6 +92,74 @@ class RubricCriterion
 };
 
 
+// How Rubric::run executes the criteria.
+struct RubricOptions
+{
+	// Number of criteria run at once, each on its own worker thread. With
+	// more than one, criteria must not depend on each other, and what each
+	// one writes to std::cout is captured and printed with its result.
+	unsigned threads = 1;
+	
+	// A criterion still running after this many seconds fails, and the
+	// rest of the rubric carries on without it; 0 means no limit.
+	double timeout_seconds = 0;
+	
+	// Print each criterion's wall time with its result.
+	bool timing = false;
+};
+
+
+// Stream buffer installed in std::cout while criteria run on worker
+// threads: a thread that has set capture() writes into that string, and
+// every other thread writes through to the original buffer.
+class RubricOutputCapture : public std::streambuf
+{
+	public:
+		explicit RubricOutputCapture(std::streambuf* original) : _original(original) { }
+		
+		// The calling thread's capture string, or nullptr when it is not
+		// captured.
+		static std::string*& capture()
+		{
+			static thread_local std::string* target = nullptr;
+			return target;
+		}
+	
+	protected:
+		int overflow(int c) override
+		{
+			if (c == traits_type::eof())
+			{
+				return traits_type::not_eof(c);
+			}
+			if (std::string* target = capture())
+			{
+				target->push_back(char(c));
+				return c;
+			}
+			return _original->sputc(char(c));
+		}
+		
+		std::streamsize xsputn(const char* s, std::streamsize n) override
+		{
+			if (std::string* target = capture())
+			{
+				target->append(s, n);
+				return n;
+			}
+			return _original->sputn(s, n);
+		}
+		
+		int sync() override
+		{
+			return capture() ? 0 : _original->pubsync();
+		}
+	
+	private:
+		std::streambuf* _original;
+};
+
+
 // A rubric represents a mult-critera grading scheme. It collects
 // several RubricCriterion objects.
 class Rubric
@@ -105,46 +183,43 @@ class Rubric
 		// return value of main() in a unit-test program.
 		int run()
 		{
-			int earned_points(0), total_points(0);
-			bool all_passed(true);
+			return run(RubricOptions());
+		}
+		
+		// As above, executing the criteria as options says. Results are
+		// printed in criterion order either way. When a criterion times
+		// out its thread cannot be stopped and may still be using the
+		// caller's data, so after printing the total this ends the
+		// process with status 1 instead of returning.
+		int run(const RubricOptions& options)
+		{
+			std::vector<CriterionResult> results(_criteria.size());
 			
-			for ( auto& criterion : _criteria )
+			if (options.threads <= 1 && options.timeout_seconds <= 0)
 			{
-				std::cout << criterion.name() << ": ";
-
-				try
+				for (size_t i = 0; i < _criteria.size(); i++)
 				{
-					// run this criterion's test function
-					criterion.test()();
-
-					// if that function call threw an exception, we never reach these lines
-					std::cout
-						<< "passed, score "
-						<< criterion.points() << "/" << criterion.points()
-						<< std::endl
-						;
-					
-					earned_points += criterion.points();
-
+					std::cout << _criteria[i].name() << ": ";
+					run_criterion(_criteria[i], results[i]);
+					print_result(_criteria[i], results[i], options, false);
 				}
-				catch (TestFailureException e)
+			}
+			else
+			{
+				run_parallel(options, results);
+			}
+			
+			int earned_points(0), total_points(0);
+			bool all_passed(true), any_timed_out(false);
+			for (size_t i = 0; i < _criteria.size(); i++)
+			{
+				if (results[i].passed)
 				{
-					// test function threw an exception; test failed
-					std::cout
-						<< std::endl
-						<< "  TEST FAILED: " << std::endl
-						<< "  line " << e.line()
-						<< " of file " << e.file()
-						<< ", message: " << e.message()
-						<< std::endl
-						<< "  score 0/" << criterion.points()
-						<< std::endl
-						;
-					
-					all_passed = false;
+					earned_points += _criteria[i].points();
 				}
-				
-				total_points += criterion.points();
+				all_passed = all_passed && results[i].passed;
+				any_timed_out = any_timed_out || results[i].timed_out;
+				total_points += _criteria[i].points();
 			}
 
 			// print summary score
@@ -155,6 +230,12 @@ class Rubric
 				<< std::endl
 				;
 			
+			if (any_timed_out)
+			{
+				std::cout.flush();
+				std::_Exit(1);
+			}
+			
 			if (all_passed)
 			{
 				return 0;
@@ -165,6 +246,232 @@ class Rubric
 			}
 		}
 	
+	private:
+		// The outcome of one criterion.
+		struct CriterionResult
+		{
+			bool passed = false;
+			bool timed_out = false;
+			
+			// Failure report, empty when passed.
+			std::string failure;
+			
+			// What the criterion wrote to std::cout, when captured.
+			std::string output;
+			
+			double seconds = 0;
+		};
+		
+		// Bookkeeping shared between run_parallel and its workers; held by
+		// shared_ptr so that a worker stuck past its timeout can outlive
+		// the run.
+		struct ParallelState
+		{
+			std::mutex mutex;
+			std::condition_variable changed;
+			
+			size_t next = 0;
+			std::vector<CriterionResult> results;
+			std::vector<bool> done;
+			std::vector<bool> running;
+			std::vector<std::chrono::steady_clock::time_point> started;
+		};
+		
+		// Run one criterion, recording whether it passed and how long it
+		// took.
+		static void run_criterion(const RubricCriterion& criterion, CriterionResult& result)
+		{
+			auto start = std::chrono::steady_clock::now();
+			try
+			{
+				// run this criterion's test function
+				criterion.test()();
+				
+				// if that function call threw an exception, we never reach this line
+				result.passed = true;
+			}
+			catch (TestFailureException e)
+			{
+				// test function threw an exception; test failed
+				result.failure =
+					"  line " + std::to_string(e.line())
+					+ " of file " + e.file()
+					+ ", message: " + e.message()
+					;
+			}
+			catch (const std::exception& e)
+			{
+				result.failure = std::string("  unexpected exception: ") + e.what();
+			}
+			catch (...)
+			{
+				result.failure = "  unexpected exception";
+			}
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		
+		// Print a criterion's result; with_name when the name has not been
+		// printed yet.
+		static void print_result(
+			const RubricCriterion& criterion,
+			const CriterionResult& result,
+			const RubricOptions& options,
+			bool with_name)
+		{
+			if (with_name)
+			{
+				std::cout << criterion.name() << ": ";
+			}
+			if (!result.output.empty())
+			{
+				std::cout << std::endl << result.output;
+				if (result.output.back() != '\n')
+				{
+					std::cout << std::endl;
+				}
+				std::cout << "  ";
+			}
+			
+			if (result.passed)
+			{
+				std::cout
+					<< "passed, score "
+					<< criterion.points() << "/" << criterion.points()
+					;
+			}
+			else
+			{
+				std::cout
+					<< std::endl
+					<< "  TEST FAILED: " << std::endl
+					<< result.failure
+					<< std::endl
+					<< "  score 0/" << criterion.points()
+					;
+			}
+			if (options.timing)
+			{
+				std::cout << " (" << result.seconds << " s)";
+			}
+			std::cout << std::endl;
+		}
+		
+		// Run the criteria on options.threads workers, printing results in
+		// criterion order as they become available.
+		void run_parallel(const RubricOptions& options, std::vector<CriterionResult>& results)
+		{
+			const size_t count = _criteria.size();
+			auto state = std::make_shared<ParallelState>();
+			state->results.resize(count);
+			state->done.assign(count, false);
+			state->running.assign(count, false);
+			state->started.resize(count);
+			
+			// Workers copy the criteria so that an abandoned one never
+			// refers to this rubric.
+			auto criteria = std::make_shared<const std::vector<RubricCriterion>>(_criteria);
+			
+			std::streambuf* original = std::cout.rdbuf();
+			RubricOutputCapture* capture = new RubricOutputCapture(original);
+			std::cout.rdbuf(capture);
+			
+			auto worker = [state, criteria]()
+			{
+				for (;;)
+				{
+					size_t i;
+					{
+						std::lock_guard<std::mutex> lock(state->mutex);
+						if (state->next == criteria->size())
+						{
+							return;
+						}
+						i = state->next++;
+						state->running[i] = true;
+						state->started[i] = std::chrono::steady_clock::now();
+					}
+					
+					CriterionResult result;
+					RubricOutputCapture::capture() = &result.output;
+					run_criterion((*criteria)[i], result);
+					RubricOutputCapture::capture() = nullptr;
+					
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->running[i] = false;
+					if (!state->done[i])
+					{
+						state->results[i] = std::move(result);
+						state->done[i] = true;
+					}
+					state->changed.notify_all();
+				}
+			};
+			
+			std::vector<std::thread> workers;
+			const size_t thread_count = std::max<size_t>(1, std::min<size_t>(options.threads, count));
+			for (size_t t = 0; t < thread_count; t++)
+			{
+				workers.emplace_back(worker);
+			}
+			
+			size_t printed = 0, abandoned = 0;
+			std::unique_lock<std::mutex> lock(state->mutex);
+			while (printed < count)
+			{
+				// Fail criteria that ran out of time, and replace their
+				// workers so the remaining criteria still run
+				auto now = std::chrono::steady_clock::now();
+				for (size_t i = 0; options.timeout_seconds > 0 && i < count; i++)
+				{
+					if (state->running[i] && !state->done[i]
+						&& std::chrono::duration<double>(now - state->started[i]).count() > options.timeout_seconds)
+					{
+						CriterionResult& result = state->results[i];
+						result.timed_out = true;
+						result.failure = "  timed out after " + std::to_string(options.timeout_seconds) + " s";
+						result.seconds = options.timeout_seconds;
+						state->done[i] = true;
+						abandoned++;
+						workers.emplace_back(worker);
+					}
+				}
+				
+				while (printed < count && state->done[printed])
+				{
+					results[printed] = state->results[printed];
+					lock.unlock();
+					print_result(_criteria[printed], results[printed], options, true);
+					lock.lock();
+					printed++;
+				}
+				
+				if (printed < count)
+				{
+					state->changed.wait_for(lock, std::chrono::milliseconds(options.timeout_seconds > 0 ? 10 : 1000));
+				}
+			}
+			lock.unlock();
+			
+			if (abandoned == 0)
+			{
+				for (auto& thread : workers)
+				{
+					thread.join();
+				}
+				std::cout.rdbuf(original);
+				delete capture;
+			}
+			else
+			{
+				// Stuck workers may still write through capture, so keep
+				// it installed until the process ends
+				for (auto& thread : workers)
+				{
+					thread.detach();
+				}
+			}
+		}
+		
 	private:
 		std::vector<RubricCriterion> _criteria;
 };
@@ -214,6 +521,64 @@ class Rubric
 #define TEST_LE(message, x, y) \
  TEST_TRUE(message, (x) <= (y))
 
+// Performance tests. These time an expression by evaluating it once to
+// warm up and then repetitions more times, and compare the median wall
+// time against a budget or against another expression, so that one slow
+// outlier (a context switch, say) does not fail the test. Keep the timed
+// expressions free of side effects the test depends on.
+
+// Number of timed evaluations in the TEST_... performance macros.
+const int RUBRIC_PERFORMANCE_REPETITIONS = 5;
+
+// Median wall time of repetitions calls to f, in seconds, after one
+// untimed warm-up call.
+inline double rubric_median_seconds(const std::function<void()>& f, int repetitions)
+{
+	assert(repetitions > 0);
+	f();
+	
+	std::vector<double> seconds;
+	for (int i = 0; i < repetitions; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(seconds.begin(), seconds.end());
+	size_t middle = seconds.size() / 2;
+	return seconds.size() % 2 ? seconds[middle] : (seconds[middle - 1] + seconds[middle]) / 2;
+}
+
+// A number formatted for a failure message.
+inline std::string rubric_format(double x)
+{
+	std::ostringstream ss;
+	ss << x;
+	return ss.str();
+}
+
+// Expects the median time to evaluate (expr) to be at most (seconds).
+#define TEST_WITHIN_BUDGET(message, seconds, expr) \
+ { \
+  double rubric_median = rubric_median_seconds([&]() { (void)(expr); }, RUBRIC_PERFORMANCE_REPETITIONS); \
+  if (rubric_median > (seconds)) { \
+   TEST_FAIL(std::string(message) + ": median " + rubric_format(rubric_median) \
+    + " s exceeds budget " + rubric_format(seconds) + " s"); \
+  } \
+ }
+
+// Expects evaluating (fast) to be at least (factor) times faster than
+// evaluating (slow), comparing median times.
+#define TEST_FASTER_THAN(message, factor, fast, slow) \
+ { \
+  double rubric_fast = rubric_median_seconds([&]() { (void)(fast); }, RUBRIC_PERFORMANCE_REPETITIONS); \
+  double rubric_slow = rubric_median_seconds([&]() { (void)(slow); }, RUBRIC_PERFORMANCE_REPETITIONS); \
+  if (rubric_fast * (factor) > rubric_slow) { \
+   TEST_FAIL(std::string(message) + ": median " + rubric_format(rubric_fast) \
+    + " s is not " + rubric_format(factor) + "x faster than " + rubric_format(rubric_slow) + " s"); \
+  } \
+ }
+
 ///////////////////////////////////////////////////////////////////////////////
 // rubrictest.hh
 ///////////////////////////////////////////////////////////////////////////////
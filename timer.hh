@@ -1,7 +1,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 // timer.hh
 //
-// Timer class for code timing.
+// Timer class for code timing, and PerfCounters for reading hardware
+// performance counters (Linux only) around the same code.
 //
 // This class depends only on the C++11 STL so it ought to be
 // portable. It uses the std::clock() function which is precise to
@@ -16,12 +17,30 @@
 //  double elapsed = timer.elapsed();
 //  cout << "Elapsed time in seconds: " << elapsed << endl;
 //
+//  // hardware counters; available() is false when the kernel or
+//  // hardware does not allow them
+//  PerfCounters counters;
+//  counters.start();
+//  // run the code you want measured
+//  PerfCounterValues values = counters.stop();
+//  cout << "IPC: " << values.ipc() << endl;
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #pragma once
 
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 class Timer {
  /*
@@ -51,3 +70,126 @@ public:
  private:
  std::chrono::high_resolution_clock::time_point _start;
 };
+
+// Values read by PerfCounters. A counter the kernel or hardware does not
+// provide reads as NaN.
+struct PerfCounterValues {
+ double cycles = NAN;
+ double instructions = NAN;
+ double cache_misses = NAN;
+ double branch_misses = NAN;
+ double llc_loads = NAN;
+
+ // Instructions per cycle.
+ double ipc() const {
+  return instructions / cycles;
+ }
+};
+
+// Hardware performance counters of the calling thread (user space only),
+// read with Linux perf_event_open. Each counter is opened separately, so
+// the ones that are available are still read when others are not; counts
+// are scaled up when the kernel had to multiplex them.
+class PerfCounters {
+public:
+ enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, LLC_LOADS, COUNT };
+
+ PerfCounters() {
+  for (int i = 0; i < COUNT; i++) {
+   _fd[i] = -1;
+  }
+#ifdef __linux__
+  const uint64_t llc_loads =
+   PERF_COUNT_HW_CACHE_LL
+   | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+   | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16);
+  open_counter(CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  open_counter(INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  open_counter(CACHE_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  open_counter(BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  open_counter(LLC_LOADS, PERF_TYPE_HW_CACHE, llc_loads);
+#endif
+ }
+
+ PerfCounters(const PerfCounters&) = delete;
+ PerfCounters& operator=(const PerfCounters&) = delete;
+
+ ~PerfCounters() {
+#ifdef __linux__
+  for (int i = 0; i < COUNT; i++) {
+   if (_fd[i] >= 0) {
+    close(_fd[i]);
+   }
+  }
+#endif
+ }
+
+ // True when at least one counter could be opened.
+ bool available() const {
+  for (int i = 0; i < COUNT; i++) {
+   if (_fd[i] >= 0) {
+    return true;
+   }
+  }
+  return false;
+ }
+
+ // Zero and start all counters.
+ void start() {
+#ifdef __linux__
+  for (int i = 0; i < COUNT; i++) {
+   if (_fd[i] >= 0) {
+    ioctl(_fd[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+   }
+  }
+#endif
+ }
+
+ // Stop all counters and return their values since start().
+ PerfCounterValues stop() {
+  double value[COUNT];
+  for (int i = 0; i < COUNT; i++) {
+   value[i] = NAN;
+  }
+#ifdef __linux__
+  for (int i = 0; i < COUNT; i++) {
+   if (_fd[i] >= 0) {
+    ioctl(_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+   }
+  }
+  for (int i = 0; i < COUNT; i++) {
+   // count, time enabled, time running
+   uint64_t data[3];
+   if (_fd[i] >= 0 && read(_fd[i], data, sizeof(data)) == sizeof(data) && data[2] > 0) {
+    value[i] = double(data[0]) * double(data[1]) / double(data[2]);
+   }
+  }
+#endif
+  PerfCounterValues values;
+  values.cycles = value[CYCLES];
+  values.instructions = value[INSTRUCTIONS];
+  values.cache_misses = value[CACHE_MISSES];
+  values.branch_misses = value[BRANCH_MISSES];
+  values.llc_loads = value[LLC_LOADS];
+  return values;
+ }
+
+private:
+#ifdef __linux__
+ void open_counter(int index, uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  _fd[index] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+ }
+#endif
+
+ int _fd[COUNT];
+};
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// worker_pool.hh
+//
+// A fixed set of worker threads that run submitted tasks in FIFO order.
+//
+// How to use:
+//
+//  WorkerPool pool(4);
+//  auto answer = pool.async([]() { return 6 * 7; });
+//  pool.submit([]() { std::cout << "hello" << std::endl; });
+//  std::cout << answer.get() << std::endl;
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+class WorkerPool
+{
+	//
+	public:
+		// Start threads workers; 0 means one per core.
+		explicit WorkerPool(unsigned threads = 0)
+		{
+			if (threads == 0)
+			{
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			for (unsigned i = 0; i < threads; i++)
+			{
+				_workers.emplace_back([this]() { work(); });
+			}
+		}
+		
+		// Run every task already submitted, then stop the workers.
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_changed.notify_all();
+			for (auto& worker : _workers)
+			{
+				worker.join();
+			}
+		}
+		
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+		
+		// Queue task to run on a worker.
+		void submit(std::function<void()> task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_tasks.push_back(std::move(task));
+			}
+			_changed.notify_one();
+		}
+		
+		// Queue f to run on a worker; the future holds its result, or the
+		// exception it threw.
+		template <typename Function>
+		std::future<std::invoke_result_t<Function>> async(Function f)
+		{
+			auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Function>()>>(std::move(f));
+			auto result = task->get_future();
+			submit([task]() { (*task)(); });
+			return result;
+		}
+		
+		// Block until every submitted task has finished.
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_idle.wait(lock, [this]() { return _tasks.empty() && _active == 0; });
+		}
+		
+		size_t size() const { return _workers.size(); }
+	
+	//
+	private:
+		void work()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			for (;;)
+			{
+				_changed.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+				if (_tasks.empty())
+				{
+					return;
+				}
+				
+				std::function<void()> task = std::move(_tasks.front());
+				_tasks.pop_front();
+				_active++;
+				lock.unlock();
+				task();
+				lock.lock();
+				_active--;
+				if (_tasks.empty() && _active == 0)
+				{
+					_idle.notify_all();
+				}
+			}
+		}
+		
+		std::mutex _mutex;
+		std::condition_variable _changed, _idle;
+		std::deque<std::function<void()>> _tasks;
+		size_t _active = 0;
+		bool _stopping = false;
+		std::vector<std::thread> _workers;
+};